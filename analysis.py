@@ -1,14 +1,20 @@
 import sys
+from concurrent.futures import ThreadPoolExecutor
 import numpy as np
-import pandas as pd
-from sklearn.metrics import silhouette_score
+import mysymnmf as sf
 from symnmf import symnmf
 from kmeans import kmeans 
 
 def read_data(file_path):
     """Reads data points from a file."""
-    data = pd.read_csv(file_path, header=None)
-    return data.values.tolist()
+    return np.asarray(sf.load_matrix(file_path))
+
+def kmeans_clustering(k, file_name, batch_size=None):
+    """Performs the k-means baseline: full batch, or mini-batch reading batch_size points at a time."""
+    if batch_size is None:
+        return kmeans(k, file_name)
+    _, labels = sf.minibatch_kmeans(file_name, k, batch_size)
+    return np.asarray(labels)
 
 def symnmf_clustering(k, matrix):
     """Performs clustering using SymNMF."""
@@ -18,16 +24,22 @@ def symnmf_clustering(k, matrix):
 
 def main():
     try:
-        if len(sys.argv) != 3:
+        # analysis.py k file_name [batch_size]: a batch size switches the k-means baseline to
+        # mini-batch k-means, which reads the file in batches instead of loading it
+        if len(sys.argv) not in (3, 4):
             raise ValueError("Invalid number of arguments")
         k = int(sys.argv[1])
         file_name = sys.argv[2]
+        batch_size = int(sys.argv[3]) if len(sys.argv) == 4 else None
         matrix = read_data(file_name)
-        symnmf_labels = symnmf_clustering(k, matrix)
-        symnmf_score = silhouette_score(matrix, symnmf_labels)
+        # The C kernels release the GIL, so SymNMF runs alongside the Python k-means
+        with ThreadPoolExecutor(max_workers=1) as executor:
+            symnmf_future = executor.submit(symnmf_clustering, k, matrix)
+            kmeans_labels = kmeans_clustering(k, file_name, batch_size)
+            symnmf_labels = symnmf_future.result()
+        symnmf_score, _ = sf.silhouette(matrix, symnmf_labels)
         print(f"nmf: {symnmf_score:.4f}")
-        kmeans_labels = kmeans(k, file_name)
-        kmeans_score = silhouette_score(matrix, kmeans_labels)
+        kmeans_score, _ = sf.silhouette(matrix, kmeans_labels)
         print(f"kmeans: {kmeans_score:.4f}")
     except Exception as e:
         print("An Error Has Occurred")
@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gemm.h"
+
+/* Largest number of floating point operations spent on one timed run of the naive loop */
+#define NAIVE_FLOP_BUDGET 4e9
+
+/* Helper function to read a monotonic wall clock in seconds */
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* The i-j-k triple loop multiply_matrices used before the blocked kernel, on rows [0, rows) of C */
+static void naive_multiply(int rows, int n, const double *a, const double *b, double *c) {
+    int i, j, k;
+    double sum;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < n; j++) {
+            sum = 0.0;
+            for (k = 0; k < n; k++) {
+                sum += a[(size_t)i * n + k] * b[(size_t)k * n + j];
+            }
+            c[(size_t)i * n + j] = sum;
+        }
+    }
+}
+
+/* Helper function to allocate an aligned buffer of count pseudo-random values */
+static double* random_buffer(size_t count) {
+    void *buffer = NULL;
+    size_t i;
+    if (posix_memalign(&buffer, 64, count * sizeof(double)) != 0) {
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        ((double *)buffer)[i] = (double)rand() / RAND_MAX;
+    }
+    return (double *)buffer;
+}
+
+/* Benchmarks C = A * B for n x n operands on the first rows rows of C.
+ * Both kernels compute the same rows, so GFLOP/s are directly comparable even when
+ * rows < n keeps the naive loop (and the memory footprint of C) within budget. */
+static int bench_size(int n, int rows) {
+    double *a, *b, *c_naive, *c_blocked, flops, start, naive_time, blocked_time, max_error, diff;
+    int naive_rows;
+    size_t i;
+    a = random_buffer((size_t)rows * n);
+    b = random_buffer((size_t)n * n);
+    c_naive = random_buffer((size_t)rows * n);
+    c_blocked = random_buffer((size_t)rows * n);
+    if (a == NULL || b == NULL || c_naive == NULL || c_blocked == NULL) {
+        fprintf(stderr, "n=%d: allocation failed\n", n);
+        free(a);
+        free(b);
+        free(c_naive);
+        free(c_blocked);
+        return 0;
+    }
+    naive_rows = rows;
+    if (2.0 * naive_rows * n * n > NAIVE_FLOP_BUDGET) {
+        naive_rows = (int)(NAIVE_FLOP_BUDGET / (2.0 * n * n));
+        if (naive_rows < 1) {
+            naive_rows = 1;
+        }
+    }
+    start = wall_time();
+    naive_multiply(naive_rows, n, a, b, c_naive);
+    naive_time = wall_time() - start;
+    start = wall_time();
+    gemm(rows, n, n, a, (size_t)n, 0, b, (size_t)n, c_blocked, (size_t)n, 0, NULL);
+    blocked_time = wall_time() - start;
+    max_error = 0.0;
+    for (i = 0; i < (size_t)naive_rows * n; i++) {
+        diff = c_naive[i] - c_blocked[i];
+        if (diff < 0) {
+            diff = -diff;
+        }
+        if (diff > max_error) {
+            max_error = diff;
+        }
+    }
+    flops = 2.0 * n * n;
+    printf("%6d %6d %10.3f %10.3f %8.1fx %10.2e\n", n, rows,
+           flops * naive_rows / naive_time * 1e-9, flops * rows / blocked_time * 1e-9,
+           (naive_time / naive_rows) / (blocked_time / rows), max_error);
+    free(a);
+    free(b);
+    free(c_naive);
+    free(c_blocked);
+    return 1;
+}
+
+/* Usage: bench_gemm [-r rows] [n ...]
+ * Defaults to n = 1000 5000 20000. -r caps the number of rows of C that are computed,
+ * which keeps the n = 20000 case within a few GB of memory. */
+int main(int argc, char *argv[]) {
+    int default_sizes[3] = {1000, 5000, 20000};
+    int i, n, max_rows = 0, ran = 0;
+    printf("gemm kernel: %s\n", gemm_kernel_name());
+    printf("%6s %6s %10s %10s %9s %10s\n", "n", "rows", "naive", "blocked", "speedup", "max_err");
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            max_rows = atoi(argv[++i]);
+            continue;
+        }
+        n = atoi(argv[i]);
+        if (n <= 0) {
+            fprintf(stderr, "Invalid size: %s\n", argv[i]);
+            return 1;
+        }
+        bench_size(n, (max_rows > 0 && max_rows < n) ? max_rows : n);
+        ran = 1;
+    }
+    for (i = 0; !ran && i < 3; i++) {
+        n = default_sizes[i];
+        bench_size(n, (max_rows > 0 && max_rows < n) ? max_rows : (n > 5000 ? 1000 : n));
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "symnmf.h"
+#include "gemm.h"
+#include "rng.h"
+
+/* Most updates any rule gets to reach the target objective */
+#define BENCH_MAX_ITER 1000
+
+/* Squared distance between iterates below which a rule is considered stuck */
+#define BENCH_STALL 1e-14
+
+/* Relative slack on the target objective, so that rounding does not decide a tie */
+#define BENCH_SLACK 1e-9
+
+/* Synthetic data sets: points, dimension and clusters */
+#define BENCH_SYNTHETIC 3
+static const int synthetic_sizes[BENCH_SYNTHETIC][3] = {{500, 8, 6}, {1500, 10, 8}, {3000, 10, 10}};
+
+/* Helper function to read a monotonic wall clock in seconds */
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Helper function to compute ||W - H H^T||_F^2 = ||W||_F^2 - 2 tr(H^T W H) + ||H^T H||_F^2 */
+static double objective(Matrix *W, double w_norm_squared, Matrix *H, Matrix *WH, Matrix *HtH) {
+    int i, j;
+    double value, *h_row, *wh_row, *hth_row;
+    if (!symm(H->rows, H->cols, W->data, (size_t)W->stride, H->data, (size_t)H->stride,
+              WH->data, (size_t)WH->stride, NULL)) {
+        return -1.0;
+    }
+    syrk(H->rows, H->cols, H->data, (size_t)H->stride, HtH->data, (size_t)HtH->stride);
+    value = w_norm_squared;
+    for (i = 0; i < H->rows; i++) {
+        h_row = MATRIX_ROW(H, i);
+        wh_row = MATRIX_ROW(WH, i);
+        for (j = 0; j < H->cols; j++) {
+            value -= 2 * h_row[j] * wh_row[j];
+        }
+    }
+    for (i = 0; i < H->cols; i++) {
+        hth_row = MATRIX_ROW(HtH, i);
+        for (j = 0; j < H->cols; j++) {
+            value += hth_row[j] * hth_row[j];
+        }
+    }
+    return value;
+}
+
+/* Helper function to get the H a solver would return now: its iterate, or for the ANLS rule the
+ * projection (G + H) / 2 of its two factors, written into projected */
+static Matrix* current_solution(SymnmfSolver *solver, Matrix *projected) {
+    int i, j;
+    if (solver->method != SYMNMF_ANLS) {
+        return solver->H;
+    }
+    for (i = 0; i < projected->rows; i++) {
+        for (j = 0; j < projected->cols; j++) {
+            MATRIX_ROW(projected, i)[j] = 0.5 * (MATRIX_ROW(solver->H, i)[j] + MATRIX_ROW(solver->G, i)[j]);
+        }
+    }
+    return projected;
+}
+
+/* Helper function to draw n points of dimension d around k uniformly placed centers */
+static Matrix* synthetic_blobs(int n, int d, int k, unsigned long seed) {
+    Matrix *centers, *points;
+    RandomState state;
+    int i, c;
+    double *row, *center;
+    centers = random_uniform_matrix(k, d, seed);
+    points = initialize_matrix_with_zeros(n, d);
+    if (centers == NULL || points == NULL) {
+        free_matrix(centers);
+        free_matrix(points);
+        return NULL;
+    }
+    seed_random(&state, seed + 1);
+    for (i = 0; i < n; i++) {
+        row = MATRIX_ROW(points, i);
+        center = MATRIX_ROW(centers, i % k);
+        for (c = 0; c < d; c++) {
+            row[c] = 4.0 * center[c] + random_uniform(&state) + random_uniform(&state) - 1.0;
+        }
+    }
+    free_matrix(centers);
+    return points;
+}
+
+/* Times every update rule on one data set. The target is the objective the default rule
+ * (multiplicative, SYMNMF_MAX_ITER, SYMNMF_EPS) stops at; each rule starts from the same H
+ * and is timed until its objective is no larger. Only the updates are timed, for the default
+ * rule as for the others: solvers are created and objectives evaluated off the clock. */
+static int bench_data_set(const char *name, Matrix *X, int k) {
+    const char *method_names[4] = {"mu", "nesterov", "hals", "anls"};
+    Matrix *W, *U, *H, *WH, *HtH;
+    SymnmfOptions options;
+    SymnmfSolver *solver;
+    double w_norm_squared, target, value, start, seconds, reference_seconds, distance, *row;
+    int i, j, n, method, iter, reached;
+    n = X->rows;
+    W = norm(X);
+    U = random_uniform_matrix(n, k, 1);
+    WH = initialize_matrix_with_zeros(n, k);
+    HtH = initialize_matrix_with_zeros(k, k);
+    H = NULL;
+    if (W != NULL && U != NULL) {
+        H = scaled_matrix(U, 2 * sqrt(matrix_mean(W) / k));
+    }
+    if (H == NULL || WH == NULL || HtH == NULL) {
+        fprintf(stderr, "%s: allocation failed\n", name);
+        free_matrix(W);
+        free_matrix(U);
+        free_matrix(WH);
+        free_matrix(HtH);
+        return 0;
+    }
+    w_norm_squared = 0.0;
+    for (i = 0; i < n; i++) {
+        row = MATRIX_ROW(W, i);
+        for (j = 0; j < n; j++) {
+            w_norm_squared += row[j] * row[j];
+        }
+    }
+    default_symnmf_options(&options);
+    solver = create_symnmf_solver(H, W);
+    if (solver != NULL && !set_symnmf_method(solver, options.method)) {
+        free_symnmf_solver(solver);
+        solver = NULL;
+    }
+    reference_seconds = 0.0;
+    target = solver == NULL ? -1.0 : 0.0;
+    for (iter = 0; solver != NULL && iter < options.max_iter; iter++) {
+        /* The stopping rule of run_symnmf_solver under the default options */
+        start = wall_time();
+        distance = symnmf_step(solver);
+        reference_seconds += wall_time() - start;
+        if (distance < 0) {
+            target = -1.0;
+            break;
+        }
+        if (distance < options.eps) {
+            break;
+        }
+    }
+    if (target >= 0) {
+        target = objective(W, w_norm_squared, solver->H, WH, HtH);
+    }
+    free_symnmf_solver(solver);
+    printf("%-12s %6d %3d  default rule: %.4f s, relative error %.6f\n", name, n, k,
+           reference_seconds, sqrt(target / w_norm_squared));
+    for (method = 0; method < 4 && target >= 0; method++) {
+        solver = create_symnmf_solver(H, W);
+        if (solver == NULL || !set_symnmf_method(solver, (SymnmfMethod)method)) {
+            free_symnmf_solver(solver);
+            break;
+        }
+        seconds = 0.0;
+        reached = 0;
+        value = -1.0;
+        for (iter = 1; iter <= BENCH_MAX_ITER; iter++) {
+            start = wall_time();
+            distance = symnmf_step(solver);
+            seconds += wall_time() - start;
+            /* U is not needed once H is drawn, and holds the projection of the ANLS factors */
+            value = objective(W, w_norm_squared, current_solution(solver, U), WH, HtH);
+            if (distance < 0 || value < 0) {
+                break;
+            }
+            if (value <= target * (1 + BENCH_SLACK)) {
+                reached = 1;
+                break;
+            }
+            if (distance < BENCH_STALL) {
+                break;
+            }
+        }
+        printf("%-12s %6d %3d  %-8s %6d %10.4f %9.2fx %12.6f%s\n", name, n, k, method_names[method],
+               iter > BENCH_MAX_ITER ? BENCH_MAX_ITER : iter, seconds, reached ? reference_seconds / seconds : 0.0,
+               sqrt(value / w_norm_squared), reached ? "" : "  (target not reached)");
+        free_symnmf_solver(solver);
+    }
+    free_matrix(W);
+    free_matrix(U);
+    free_matrix(H);
+    free_matrix(WH);
+    free_matrix(HtH);
+    return 1;
+}
+
+/* Usage: bench_symnmf [file k ...]
+ * Defaults to the tests/ inputs and three synthetic blob data sets. For every data set and
+ * update rule it prints the updates and seconds needed to reach the objective of the default
+ * rule, the speedup over the default rule and the relative error ||W - H H^T||_F / ||W||_F. */
+int main(int argc, char *argv[]) {
+    const char *test_files[3] = {"tests/input_1.txt", "tests/input_2.txt", "tests/input_3.txt"};
+    int test_ks[3] = {5, 4, 7};
+    char name[32];
+    Matrix *X;
+    int i, k;
+    printf("%-12s %6s %3s  %-8s %6s %10s %10s %12s\n", "data", "n", "k", "method", "iters", "seconds",
+           "speedup", "rel_error");
+    for (i = 1; i + 1 < argc; i += 2) {
+        k = atoi(argv[i + 1]);
+        X = load_matrix_from_file(argv[i]);
+        if (X == NULL || k < 1 || k >= X->rows) {
+            fprintf(stderr, "Invalid data set: %s %s\n", argv[i], argv[i + 1]);
+            free_matrix(X);
+            return 1;
+        }
+        bench_data_set(argv[i], X, k);
+        free_matrix(X);
+    }
+    if (argc > 1) {
+        return 0;
+    }
+    for (i = 0; i < 3; i++) {
+        X = load_matrix_from_file(test_files[i]);
+        if (X != NULL) {
+            bench_data_set(test_files[i] + 6, X, test_ks[i]);
+        }
+        free_matrix(X);
+    }
+    for (i = 0; i < BENCH_SYNTHETIC; i++) {
+        X = synthetic_blobs(synthetic_sizes[i][0], synthetic_sizes[i][1], synthetic_sizes[i][2], (unsigned long)i + 1);
+        if (X != NULL) {
+            sprintf(name, "blobs_%d", synthetic_sizes[i][0]);
+            bench_data_set(name, X, synthetic_sizes[i][2]);
+        }
+        free_matrix(X);
+    }
+    return 0;
+}
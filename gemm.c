@@ -0,0 +1,381 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+#include "gemm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_X86
+#include <immintrin.h>
+#endif
+
+#define GEMM_ALIGNMENT 64
+#define GEMM_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Computes an mr x nr tile of C from a packed A micro-panel and a packed B micro-panel */
+typedef void (*GemmMicroKernel)(int kc, const double *a, const double *b, double *c, size_t ldc, int accumulate);
+
+typedef struct GemmKernel {
+    const char *name;
+    int mr;
+    int nr;
+    GemmMicroKernel run;
+} GemmKernel;
+
+/* Portable 4x4 micro-kernel */
+static void micro_kernel_scalar(int kc, const double *a, const double *b, double *c, size_t ldc, int accumulate) {
+    double acc[4][4];
+    int p, i, j;
+    memset(acc, 0, sizeof(acc));
+    for (p = 0; p < kc; p++) {
+        for (i = 0; i < 4; i++) {
+            for (j = 0; j < 4; j++) {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+        a += 4;
+        b += 4;
+    }
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+#ifdef GEMM_X86
+
+#define AVX2_FMA_ROW(r) \
+    a_value = _mm256_broadcast_sd(a + r); \
+    c##r##0 = _mm256_fmadd_pd(a_value, b0, c##r##0); \
+    c##r##1 = _mm256_fmadd_pd(a_value, b1, c##r##1);
+
+#define AVX2_STORE_ROW(r) \
+    if (accumulate) { \
+        c##r##0 = _mm256_add_pd(c##r##0, _mm256_loadu_pd(c + r * ldc)); \
+        c##r##1 = _mm256_add_pd(c##r##1, _mm256_loadu_pd(c + r * ldc + 4)); \
+    } \
+    _mm256_storeu_pd(c + r * ldc, c##r##0); \
+    _mm256_storeu_pd(c + r * ldc + 4, c##r##1);
+
+/* AVX2 + FMA 6x8 micro-kernel: twelve ymm accumulators, two B vectors and one broadcast */
+__attribute__((target("avx2,fma")))
+static void micro_kernel_avx2(int kc, const double *a, const double *b, double *c, size_t ldc, int accumulate) {
+    __m256d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+    __m256d a_value, b0, b1;
+    int p;
+    c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_pd();
+    c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_pd();
+    for (p = 0; p < kc; p++) {
+        b0 = _mm256_load_pd(b);
+        b1 = _mm256_load_pd(b + 4);
+        AVX2_FMA_ROW(0)
+        AVX2_FMA_ROW(1)
+        AVX2_FMA_ROW(2)
+        AVX2_FMA_ROW(3)
+        AVX2_FMA_ROW(4)
+        AVX2_FMA_ROW(5)
+        a += 6;
+        b += 8;
+    }
+    AVX2_STORE_ROW(0)
+    AVX2_STORE_ROW(1)
+    AVX2_STORE_ROW(2)
+    AVX2_STORE_ROW(3)
+    AVX2_STORE_ROW(4)
+    AVX2_STORE_ROW(5)
+}
+
+#define AVX512_FMA_ROW(r) \
+    a_value = _mm512_set1_pd(a[r]); \
+    c##r##0 = _mm512_fmadd_pd(a_value, b0, c##r##0); \
+    c##r##1 = _mm512_fmadd_pd(a_value, b1, c##r##1);
+
+#define AVX512_STORE_ROW(r) \
+    if (accumulate) { \
+        c##r##0 = _mm512_add_pd(c##r##0, _mm512_loadu_pd(c + r * ldc)); \
+        c##r##1 = _mm512_add_pd(c##r##1, _mm512_loadu_pd(c + r * ldc + 8)); \
+    } \
+    _mm512_storeu_pd(c + r * ldc, c##r##0); \
+    _mm512_storeu_pd(c + r * ldc + 8, c##r##1);
+
+/* AVX-512 6x16 micro-kernel: twelve zmm accumulators, two B vectors and one broadcast */
+__attribute__((target("avx512f")))
+static void micro_kernel_avx512(int kc, const double *a, const double *b, double *c, size_t ldc, int accumulate) {
+    __m512d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+    __m512d a_value, b0, b1;
+    int p;
+    c00 = c01 = c10 = c11 = c20 = c21 = _mm512_setzero_pd();
+    c30 = c31 = c40 = c41 = c50 = c51 = _mm512_setzero_pd();
+    for (p = 0; p < kc; p++) {
+        b0 = _mm512_load_pd(b);
+        b1 = _mm512_load_pd(b + 8);
+        AVX512_FMA_ROW(0)
+        AVX512_FMA_ROW(1)
+        AVX512_FMA_ROW(2)
+        AVX512_FMA_ROW(3)
+        AVX512_FMA_ROW(4)
+        AVX512_FMA_ROW(5)
+        a += 6;
+        b += 16;
+    }
+    AVX512_STORE_ROW(0)
+    AVX512_STORE_ROW(1)
+    AVX512_STORE_ROW(2)
+    AVX512_STORE_ROW(3)
+    AVX512_STORE_ROW(4)
+    AVX512_STORE_ROW(5)
+}
+
+#endif
+
+/* Helper function to pick the widest micro-kernel the running CPU supports */
+static GemmKernel select_kernel(void) {
+    GemmKernel kernel;
+    kernel.name = "scalar";
+    kernel.mr = 4;
+    kernel.nr = 4;
+    kernel.run = micro_kernel_scalar;
+#ifdef GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        kernel.name = "avx512";
+        kernel.mr = 6;
+        kernel.nr = 16;
+        kernel.run = micro_kernel_avx512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernel.name = "avx2";
+        kernel.mr = 6;
+        kernel.nr = 8;
+        kernel.run = micro_kernel_avx2;
+    }
+#endif
+    return kernel;
+}
+
+/* Helper function to round a count of doubles up to a whole number of cache lines */
+static size_t round_to_line(size_t count) {
+    size_t per_line = GEMM_ALIGNMENT / sizeof(double);
+    return (count + per_line - 1) / per_line * per_line;
+}
+
+/* Helper function to pack an mc x kc block of op(A) into mr-row micro-panels, zero padding the last one */
+static void pack_a(int mc, int kc, const double *a, size_t lda, int trans_a, int mr, double *packed) {
+    int i0, rows, p, i;
+    for (i0 = 0; i0 < mc; i0 += mr) {
+        rows = GEMM_MIN(mr, mc - i0);
+        for (p = 0; p < kc; p++) {
+            if (trans_a) {
+                memcpy(packed, a + (size_t)p * lda + i0, (size_t)rows * sizeof(double));
+            } else {
+                for (i = 0; i < rows; i++) {
+                    packed[i] = a[(size_t)(i0 + i) * lda + p];
+                }
+            }
+            for (i = rows; i < mr; i++) {
+                packed[i] = 0.0;
+            }
+            packed += mr;
+        }
+    }
+}
+
+/* Helper function to pack a kc x nc panel of B into nr-column micro-panels, zero padding the last one */
+static void pack_b(int kc, int nc, const double *b, size_t ldb, int nr, double *packed) {
+    int j0, cols, p, j;
+    for (j0 = 0; j0 < nc; j0 += nr) {
+        cols = GEMM_MIN(nr, nc - j0);
+        for (p = 0; p < kc; p++) {
+            memcpy(packed, b + (size_t)p * ldb + j0, (size_t)cols * sizeof(double));
+            for (j = cols; j < nr; j++) {
+                packed[j] = 0.0;
+            }
+            packed += nr;
+        }
+    }
+}
+
+/* Helper function to run the micro-kernel on a tile that may be cut off by the edge of C */
+static void run_tile(const GemmKernel *kernel, int rows, int cols, int kc, const double *a, const double *b,
+                     double *c, size_t ldc, int accumulate) {
+    double tile[GEMM_MAX_MR * GEMM_MAX_NR];
+    int i, j;
+    if (rows == kernel->mr && cols == kernel->nr) {
+        kernel->run(kc, a, b, c, ldc, accumulate);
+        return;
+    }
+    kernel->run(kc, a, b, tile, (size_t)kernel->nr, 0);
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + tile[i * kernel->nr + j] : tile[i * kernel->nr + j];
+        }
+    }
+}
+
+/* Helper function to size the packed A block; rounding up by GEMM_MAX_MR covers every kernel's mr */
+static size_t packed_a_size(int m, int k) {
+    return round_to_line((size_t)(GEMM_MIN(m, GEMM_MC) + GEMM_MAX_MR) * (size_t)GEMM_MIN(k, GEMM_KC));
+}
+
+/* Helper function to size the packed B panel; rounding up by GEMM_MAX_NR covers every kernel's nr */
+static size_t packed_b_size(int n, int k) {
+    return round_to_line((size_t)(GEMM_MIN(n, GEMM_NC) + GEMM_MAX_NR) * (size_t)GEMM_MIN(k, GEMM_KC));
+}
+
+/* Function to compute the scratch space needed by gemm */
+size_t gemm_workspace_size(int m, int n, int k) {
+    if (m <= 0 || n <= 0 || k <= 0) {
+        return 0;
+    }
+    return packed_a_size(m, k) + packed_b_size(n, k);
+}
+
+/* Function to compute C = op(A) * B with packed, cache-blocked panels */
+int gemm(int m, int n, int k, const double *a, size_t lda, int trans_a,
+         const double *b, size_t ldb, double *c, size_t ldc, int accumulate, double *workspace) {
+    GemmKernel kernel;
+    void *allocated = NULL;
+    double *packed_a, *packed_b;
+    int jc, pc, ic, jr, ir, nc, kc, mc;
+    if (m <= 0 || n <= 0) {
+        return 1;
+    }
+    if (k <= 0) {
+        if (!accumulate) {
+            for (ic = 0; ic < m; ic++) {
+                memset(c + (size_t)ic * ldc, 0, (size_t)n * sizeof(double));
+            }
+        }
+        return 1;
+    }
+    if (workspace == NULL) {
+        if (posix_memalign(&allocated, GEMM_ALIGNMENT, gemm_workspace_size(m, n, k) * sizeof(double)) != 0) {
+            return 0;
+        }
+        workspace = (double *)allocated;
+    }
+    kernel = select_kernel();
+    packed_a = workspace;
+    packed_b = workspace + packed_a_size(m, k);
+    for (jc = 0; jc < n; jc += GEMM_NC) {
+        nc = GEMM_MIN(GEMM_NC, n - jc);
+        for (pc = 0; pc < k; pc += GEMM_KC) {
+            kc = GEMM_MIN(GEMM_KC, k - pc);
+            pack_b(kc, nc, b + (size_t)pc * ldb + jc, ldb, kernel.nr, packed_b);
+            for (ic = 0; ic < m; ic += GEMM_MC) {
+                mc = GEMM_MIN(GEMM_MC, m - ic);
+                if (trans_a) {
+                    pack_a(mc, kc, a + (size_t)pc * lda + ic, lda, 1, kernel.mr, packed_a);
+                } else {
+                    pack_a(mc, kc, a + (size_t)ic * lda + pc, lda, 0, kernel.mr, packed_a);
+                }
+                for (jr = 0; jr < nc; jr += kernel.nr) {
+                    for (ir = 0; ir < mc; ir += kernel.mr) {
+                        run_tile(&kernel, GEMM_MIN(kernel.mr, mc - ir), GEMM_MIN(kernel.nr, nc - jr), kc,
+                                 packed_a + (size_t)ir * kc, packed_b + (size_t)jr * kc,
+                                 c + (size_t)(ic + ir) * ldc + jc + jr, ldc, accumulate || pc > 0);
+                    }
+                }
+            }
+        }
+    }
+    free(allocated);
+    return 1;
+}
+
+/* Function to compute the scratch space needed by symm */
+size_t symm_workspace_size(int n, int k) {
+    int block = GEMM_MIN(n, SYMM_BLOCK);
+    return gemm_workspace_size(block, k, block);
+}
+
+/* Function to compute C = W * H for a symmetric W from its lower triangle */
+int symm(int n, int k, const double *w, size_t ldw, const double *h, size_t ldh,
+         double *c, size_t ldc, double *workspace) {
+    void *allocated = NULL;
+    const double *w_block;
+    int i0, j0, rows, cols;
+    if (n <= 0 || k <= 0) {
+        return 1;
+    }
+    if (workspace == NULL) {
+        if (posix_memalign(&allocated, GEMM_ALIGNMENT, symm_workspace_size(n, k) * sizeof(double)) != 0) {
+            return 0;
+        }
+        workspace = (double *)allocated;
+    }
+    for (i0 = 0; i0 < n; i0 += SYMM_BLOCK) {
+        rows = GEMM_MIN(SYMM_BLOCK, n - i0);
+        for (j0 = 0; j0 <= i0; j0 += SYMM_BLOCK) {
+            cols = GEMM_MIN(SYMM_BLOCK, n - j0);
+            w_block = w + (size_t)i0 * ldw + j0;
+            /* C_I (+)= W_IJ * H_J; the first block of each row of blocks initializes C_I */
+            gemm(rows, k, cols, w_block, ldw, 0, h + (size_t)j0 * ldh, ldh,
+                 c + (size_t)i0 * ldc, ldc, j0 > 0, workspace);
+            if (j0 < i0) {
+                /* C_J += W_IJ^T * H_I, the contribution of the mirrored upper block W_JI */
+                gemm(cols, k, rows, w_block, ldw, 1, h + (size_t)i0 * ldh, ldh,
+                     c + (size_t)j0 * ldc, ldc, 1, workspace);
+            }
+        }
+    }
+    free(allocated);
+    return 1;
+}
+
+/* Function to compute one block row C_I of C = W * H in the order symm would */
+int symm_block_row(int n, int k, const double *w, size_t ldw, const double *h, size_t ldh,
+                   int i0, double *c, size_t ldc, double *workspace) {
+    void *allocated = NULL;
+    int j0, rows;
+    if (n <= 0 || k <= 0 || i0 >= n) {
+        return 1;
+    }
+    if (workspace == NULL) {
+        if (posix_memalign(&allocated, GEMM_ALIGNMENT, symm_workspace_size(n, k) * sizeof(double)) != 0) {
+            return 0;
+        }
+        workspace = (double *)allocated;
+    }
+    rows = GEMM_MIN(SYMM_BLOCK, n - i0);
+    for (j0 = 0; j0 <= i0; j0 += SYMM_BLOCK) {
+        /* C_I (+)= W_IJ * H_J for the blocks left of and on the diagonal */
+        gemm(rows, k, GEMM_MIN(SYMM_BLOCK, n - j0), w + (size_t)i0 * ldw + j0, ldw, 0,
+             h + (size_t)j0 * ldh, ldh, c + (size_t)i0 * ldc, ldc, j0 > 0, workspace);
+    }
+    for (j0 = i0 + SYMM_BLOCK; j0 < n; j0 += SYMM_BLOCK) {
+        /* C_I += W_JI^T * H_J for the blocks below the diagonal, read through the lower triangle */
+        gemm(rows, k, GEMM_MIN(SYMM_BLOCK, n - j0), w + (size_t)j0 * ldw + i0, ldw, 1,
+             h + (size_t)j0 * ldh, ldh, c + (size_t)i0 * ldc, ldc, 1, workspace);
+    }
+    free(allocated);
+    return 1;
+}
+
+/* Function to compute the Gram matrix A^T * A, accumulating only the upper triangle */
+void syrk(int n, int k, const double *a, size_t lda, double *c, size_t ldc) {
+    const double *row;
+    double value;
+    int r, i, j;
+    for (i = 0; i < k; i++) {
+        memset(c + (size_t)i * ldc, 0, (size_t)k * sizeof(double));
+    }
+    for (r = 0; r < n; r++) {
+        row = a + (size_t)r * lda;
+        for (i = 0; i < k; i++) {
+            value = row[i];
+            for (j = i; j < k; j++) {
+                c[(size_t)i * ldc + j] += value * row[j];
+            }
+        }
+    }
+    for (i = 0; i < k; i++) {
+        for (j = 0; j < i; j++) {
+            c[(size_t)i * ldc + j] = c[(size_t)j * ldc + i];
+        }
+    }
+}
+
+/* Function to report which micro-kernel gemm uses */
+const char* gemm_kernel_name(void) {
+    return select_kernel().name;
+}
@@ -0,0 +1,53 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+
+/* Cache blocking parameters: an MC x KC block of A stays in L2, a KC x NC panel of B in L3 */
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 4080
+
+/* Largest micro-tile of any compiled kernel */
+#define GEMM_MAX_MR 6
+#define GEMM_MAX_NR 16
+
+/* Returns the number of doubles of scratch space gemm needs for an m x n x k product */
+size_t gemm_workspace_size(int m, int n, int k);
+
+/* Computes C = op(A) * B, or C += op(A) * B when accumulate is non-zero.
+ * op(A) is m x k: A itself stored row-major with leading dimension lda, or, when trans_a
+ * is non-zero, the transpose of a k x m matrix stored with leading dimension lda.
+ * B is k x n with leading dimension ldb and C is m x n with leading dimension ldc.
+ * workspace must hold gemm_workspace_size(m, n, k) doubles aligned to 64 bytes, or be NULL
+ * to have gemm allocate it. Returns 1 on success and 0 if the workspace cannot be allocated. */
+int gemm(int m, int n, int k, const double *a, size_t lda, int trans_a,
+         const double *b, size_t ldb, double *c, size_t ldc, int accumulate, double *workspace);
+
+/* Block size in which symm walks the lower triangle of W */
+#define SYMM_BLOCK 256
+
+/* Returns the number of doubles of scratch space symm needs for an n x n by n x k product */
+size_t symm_workspace_size(int n, int k);
+
+/* Computes C = W * H for a symmetric n x n W, reading only the lower triangle of W.
+ * Each off-diagonal block W_IJ is used twice while it is in cache (C_I += W_IJ * H_J and
+ * C_J += W_IJ^T * H_I), so W is streamed from memory once per product instead of in full.
+ * workspace must hold symm_workspace_size(n, k) doubles, or be NULL. Returns 1 on success. */
+int symm(int n, int k, const double *w, size_t ldw, const double *h, size_t ldh,
+         double *c, size_t ldc, double *workspace);
+
+/* Computes the block row C_I = W_I * H of symm, rows [i0, i0 + SYMM_BLOCK), for an i0 that is a
+ * multiple of SYMM_BLOCK. The blocks of C_I are accumulated in the same order as in symm, so
+ * threads that own disjoint block rows reproduce symm bit for bit; each reads its blocks right
+ * of the diagonal through the lower triangle. workspace is as for symm. Returns 1 on success. */
+int symm_block_row(int n, int k, const double *w, size_t ldw, const double *h, size_t ldh,
+                   int i0, double *c, size_t ldc, double *workspace);
+
+/* Computes the k x k Gram matrix C = A^T * A of an n x k matrix A (both triangles are filled) */
+void syrk(int n, int k, const double *a, size_t lda, double *c, size_t ldc);
+
+/* Returns the name of the micro-kernel gemm dispatches to on this CPU */
+const char* gemm_kernel_name(void);
+
+#endif
@@ -0,0 +1,543 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "kmeans.h"
+#include "vecmath.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Bounds from a freshly computed distance, loosened by the slack away from that distance */
+#define UPPER_BOUND(distance) ((distance) * (1.0 + KMEANS_BOUND_SLACK))
+#define LOWER_BOUND(distance) ((distance) * (1.0 - KMEANS_BOUND_SLACK))
+
+/* Bounds carried over a centroid that moved by movement, by the triangle inequality */
+#define DRIFTED_UPPER_BOUND(bound, movement) (((bound) + (movement)) * (1.0 + KMEANS_BOUND_SLACK))
+#define DRIFTED_LOWER_BOUND(bound, movement) ((bound) - (movement) - KMEANS_BOUND_SLACK * ((bound) + (movement)))
+
+/* Scratch state of one k-means run */
+typedef struct KmeansState {
+    int k;
+    int d;
+    int threads;
+    int parts;
+    KmeansAlgorithm algorithm;  /* never KMEANS_AUTO */
+    int bounded;            /* 1 once upper and lower bound the distances of the current labels */
+    int packed_stride;      /* leading dimension of packed, k rounded up to a cache line */
+    double *packed;         /* coordinate-major copy of the centroids for squared_distances */
+    double *distances;      /* one row of k squared distances per thread */
+    double *part_sums;      /* per part: the sum of its points in each cluster, k x d */
+    long *part_counts;      /* per part: the number of its points in each cluster */
+    double *upper;          /* per point: upper bound on the distance to its centroid */
+    double *lower;          /* per point: lower bound on the distance to every other centroid (Hamerly),
+                             * or one lower bound per centroid (Elkan) */
+    double *movement;       /* per centroid: distance it moved in the last update */
+    double max_movement;    /* largest movement, of centroid fastest */
+    double second_movement; /* largest movement of any other centroid */
+    int fastest;
+    double *half_distances; /* k x k lower bounds on half the distances between centroids, leading
+                             * dimension packed_stride */
+    double *half_gaps;      /* per centroid: the smallest of its half distances to other centroids */
+} KmeansState;
+
+/* Function to fill options with the defaults of kmeans.py */
+void default_kmeans_options(KmeansOptions *options) {
+    options->algorithm = KMEANS_AUTO;
+    options->max_iter = KMEANS_MAX_ITER;
+    options->eps = KMEANS_EPS;
+    options->batch_size = KMEANS_BATCH_SIZE;
+}
+
+/* Function to parse the name of a k-means assignment step */
+int kmeans_algorithm_from_name(const char *name, KmeansAlgorithm *algorithm) {
+    const char *names[4] = {"lloyd", "hamerly", "elkan", "auto"};
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *algorithm = (KmeansAlgorithm)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Helper function to free the scratch state of a run */
+static void free_kmeans_state(KmeansState *state) {
+    free(state->packed);
+    free(state->distances);
+    free(state->part_sums);
+    free(state->part_counts);
+    free(state->upper);
+    free(state->lower);
+    free(state->movement);
+    free(state->half_distances);
+    free(state->half_gaps);
+}
+
+/* Helper function to allocate the scratch state for k clusters of n points of dimension d */
+static int allocate_kmeans_state(KmeansState *state, int n, int k, int d, KmeansAlgorithm algorithm) {
+    memset(state, 0, sizeof(KmeansState));
+    state->k = k;
+    state->d = d;
+#ifdef _OPENMP
+    state->threads = omp_get_max_threads();
+#else
+    state->threads = 1;
+#endif
+    state->parts = n < KMEANS_PARTS ? n : KMEANS_PARTS;
+    if (algorithm == KMEANS_AUTO) {
+        algorithm = k < KMEANS_ELKAN_MIN_K ? KMEANS_HAMERLY : KMEANS_ELKAN;
+    }
+    state->algorithm = algorithm;
+    state->packed_stride = matrix_stride(k);
+    state->packed = allocate_matrix_data(d, state->packed_stride);
+    state->distances = allocate_matrix_data(state->threads, state->packed_stride);
+    state->part_sums = allocate_matrix_data(state->parts * k, d);
+    state->part_counts = (long *)calloc((size_t)state->parts * k, sizeof(long));
+    if (state->packed == NULL || state->distances == NULL || state->part_sums == NULL
+        || state->part_counts == NULL) {
+        free_kmeans_state(state);
+        return 0;
+    }
+    if (algorithm == KMEANS_LLOYD) {
+        return 1;
+    }
+    state->upper = allocate_matrix_data(1, n);
+    state->lower = allocate_matrix_data(n, algorithm == KMEANS_ELKAN ? k : 1);
+    state->movement = allocate_matrix_data(1, k);
+    state->half_distances = allocate_matrix_data(k, state->packed_stride);
+    state->half_gaps = allocate_matrix_data(1, k);
+    if (state->upper == NULL || state->lower == NULL || state->movement == NULL
+        || state->half_distances == NULL || state->half_gaps == NULL) {
+        free_kmeans_state(state);
+        return 0;
+    }
+    return 1;
+}
+
+/* Helper function to find the nearest centroid from a row of squared distances, the first on ties */
+static int nearest_centroid(const double *distances, int k) {
+    int c, best = 0;
+    for (c = 1; c < k; c++) {
+        if (distances[c] < distances[best]) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+/* Helper function to compute the squared distance from a point to one centroid. The vector lanes
+ * of squared_distances are independent, so this is bit for bit the value of the full row. */
+static double centroid_distance(KmeansState *state, const double *point, int centroid) {
+    double distance;
+    squared_distances(point, state->packed + centroid, (size_t)state->packed_stride, 1, state->d, &distance);
+    return distance;
+}
+
+/* Helper function to bound half the distances between the centroids, for the bounded steps */
+static void measure_centroid_gaps(KmeansState *state, Matrix *centroids) {
+    int k = state->k, c, other;
+    double *half, gap;
+    for (c = 0; c < k; c++) {
+        half = state->half_distances + (size_t)c * state->packed_stride;
+        squared_distances(MATRIX_ROW(centroids, c), state->packed, (size_t)state->packed_stride, k, state->d, half);
+        gap = HUGE_VAL;
+        for (other = 0; other < k; other++) {
+            half[other] = LOWER_BOUND(0.5 * sqrt(half[other]));
+            if (other != c && half[other] < gap) {
+                gap = half[other];
+            }
+        }
+        state->half_gaps[c] = gap;
+    }
+}
+
+/* Helper function to compare a point with every centroid, resetting its bounds */
+static int assign_exhaustive(KmeansState *state, int i, const double *point, double *distances) {
+    int k = state->k, c, best;
+    double second;
+    squared_distances(point, state->packed, (size_t)state->packed_stride, k, state->d, distances);
+    best = nearest_centroid(distances, k);
+    if (state->algorithm == KMEANS_HAMERLY) {
+        second = HUGE_VAL;
+        for (c = 0; c < k; c++) {
+            if (c != best && distances[c] < second) {
+                second = distances[c];
+            }
+        }
+        state->upper[i] = UPPER_BOUND(sqrt(distances[best]));
+        state->lower[i] = LOWER_BOUND(sqrt(second));
+    } else if (state->algorithm == KMEANS_ELKAN) {
+        for (c = 0; c < k; c++) {
+            state->lower[(size_t)i * k + c] = LOWER_BOUND(sqrt(distances[c]));
+        }
+        state->upper[i] = UPPER_BOUND(sqrt(distances[best]));
+    }
+    return best;
+}
+
+/* Helper function for Hamerly's step: the point keeps its centroid while the upper bound stays
+ * below both the lower bound and half the gap to the centroid's nearest neighbor */
+static int assign_hamerly(KmeansState *state, int i, const double *point, int label, double *distances) {
+    double upper, lower, bound;
+    upper = DRIFTED_UPPER_BOUND(state->upper[i], state->movement[label]);
+    lower = DRIFTED_LOWER_BOUND(state->lower[i],
+                                label == state->fastest ? state->second_movement : state->max_movement);
+    state->upper[i] = upper;
+    state->lower[i] = lower;
+    bound = lower > state->half_gaps[label] ? lower : state->half_gaps[label];
+    if (upper < bound) {
+        return label;
+    }
+    upper = UPPER_BOUND(sqrt(centroid_distance(state, point, label)));
+    state->upper[i] = upper;
+    if (upper < bound) {
+        return label;
+    }
+    return assign_exhaustive(state, i, point, distances);
+}
+
+/* Helper function for Elkan's step: only the centroids whose lower bound and half distance from
+ * the current centroid are both within the upper bound are compared with the point. Candidates
+ * are taken in the order (distance, index), which picks the centroid the exhaustive step would. */
+static int assign_elkan(KmeansState *state, int i, const double *point, int label) {
+    int k = state->k, c, tight;
+    double upper, bound, distance, best_distance, *lower, *half;
+    lower = state->lower + (size_t)i * k;
+    for (c = 0; c < k; c++) {
+        lower[c] = DRIFTED_LOWER_BOUND(lower[c], state->movement[c]);
+    }
+    upper = DRIFTED_UPPER_BOUND(state->upper[i], state->movement[label]);
+    state->upper[i] = upper;
+    if (upper < state->half_gaps[label]) {
+        return label;
+    }
+    half = state->half_distances + (size_t)label * state->packed_stride;
+    best_distance = 0.0;
+    tight = 0;
+    for (c = 0; c < k; c++) {
+        if (c == label) {
+            continue;
+        }
+        bound = lower[c] > half[c] ? lower[c] : half[c];
+        if (upper < bound) {
+            continue;
+        }
+        if (!tight) {
+            best_distance = centroid_distance(state, point, label);
+            upper = UPPER_BOUND(sqrt(best_distance));
+            lower[label] = LOWER_BOUND(sqrt(best_distance));
+            tight = 1;
+            if (upper < bound) {
+                continue;
+            }
+        }
+        distance = centroid_distance(state, point, c);
+        lower[c] = LOWER_BOUND(sqrt(distance));
+        if (distance < best_distance || (distance == best_distance && c < label)) {
+            label = c;
+            best_distance = distance;
+            upper = UPPER_BOUND(sqrt(distance));
+            half = state->half_distances + (size_t)label * state->packed_stride;
+        }
+    }
+    state->upper[i] = upper;
+    return label;
+}
+
+/* Helper function to assign every point to its nearest centroid while summing the points of
+ * each cluster, one part of the points per thread at a time */
+static void assign_points(KmeansState *state, Matrix *points, Matrix *centroids, int *labels) {
+    int n = points->rows, d = points->cols, k = state->k, part, i, c, best;
+    long begin, end;
+    double *distances, *sums, *point, *sum;
+    long *counts;
+    /* A batch of minibatch_kmeans may hold fewer points than the state was allocated for */
+    state->parts = n < KMEANS_PARTS ? n : KMEANS_PARTS;
+    pack_coordinates(centroids->data, (size_t)centroids->stride, k, d, state->packed, (size_t)state->packed_stride);
+    if (state->bounded) {
+        measure_centroid_gaps(state, centroids);
+    }
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(state->threads) \
+        private(i, c, best, begin, end, distances, sums, point, sum, counts)
+    for (part = 0; part < state->parts; part++) {
+#ifdef _OPENMP
+        distances = state->distances + (size_t)omp_get_thread_num() * state->packed_stride;
+#else
+        distances = state->distances;
+#endif
+        sums = state->part_sums + (size_t)part * k * d;
+        counts = state->part_counts + (size_t)part * k;
+        memset(sums, 0, (size_t)k * d * sizeof(double));
+        memset(counts, 0, (size_t)k * sizeof(long));
+        begin = (long)part * n / state->parts;
+        end = (long)(part + 1) * n / state->parts;
+        for (i = (int)begin; i < (int)end; i++) {
+            point = MATRIX_ROW(points, i);
+            if (!state->bounded) {
+                best = assign_exhaustive(state, i, point, distances);
+            } else if (state->algorithm == KMEANS_HAMERLY) {
+                best = assign_hamerly(state, i, point, labels[i], distances);
+            } else {
+                best = assign_elkan(state, i, point, labels[i]);
+            }
+            labels[i] = best;
+            counts[best]++;
+            sum = sums + (size_t)best * d;
+            for (c = 0; c < d; c++) {
+                sum[c] += point[c];
+            }
+        }
+    }
+}
+
+/* Helper function to set every centroid to the mean of its points from the part sums, or to the
+ * origin when it has none */
+static void update_centroids(KmeansState *state, Matrix *centroids) {
+    int k = state->k, d = centroids->cols, part, cluster, c;
+    long count;
+    double *row;
+    for (cluster = 0; cluster < k; cluster++) {
+        row = MATRIX_ROW(centroids, cluster);
+        count = 0;
+        memset(row, 0, (size_t)d * sizeof(double));
+        for (part = 0; part < state->parts; part++) {
+            count += state->part_counts[(size_t)part * k + cluster];
+            for (c = 0; c < d; c++) {
+                row[c] += state->part_sums[((size_t)part * k + cluster) * d + c];
+            }
+        }
+        if (count != 0) {
+            for (c = 0; c < d; c++) {
+                row[c] /= count;
+            }
+        }
+    }
+}
+
+/* Helper function to check whether every centroid moved by less than eps, recording how far
+ * each one moved for the bounds */
+static int centroids_converged(KmeansState *state, Matrix *centroids, Matrix *new_centroids, double eps) {
+    int cluster, c, converged = 1;
+    double sum, diff, movement;
+    state->max_movement = 0.0;
+    state->second_movement = 0.0;
+    state->fastest = 0;
+    for (cluster = 0; cluster < centroids->rows; cluster++) {
+        sum = 0.0;
+        for (c = 0; c < centroids->cols; c++) {
+            diff = MATRIX_ROW(centroids, cluster)[c] - MATRIX_ROW(new_centroids, cluster)[c];
+            sum += diff * diff;
+        }
+        movement = sqrt(sum);
+        if (movement >= eps) {
+            converged = 0;
+        }
+        if (state->movement == NULL) {
+            continue;
+        }
+        state->movement[cluster] = movement;
+        if (movement > state->max_movement) {
+            state->second_movement = state->max_movement;
+            state->max_movement = movement;
+            state->fastest = cluster;
+        } else if (movement > state->second_movement) {
+            state->second_movement = movement;
+        }
+    }
+    return converged;
+}
+
+/* Function to run k-means from the first k points as centroids, like kmeans.py */
+Matrix* kmeans(Matrix *points, int k, const KmeansOptions *options, int *labels) {
+    int n, d, i, iteration;
+    int *assignment;
+    Matrix *centroids, *new_centroids, *swap;
+    KmeansState state;
+    if (points == NULL || k < 1 || k >= points->rows || options->max_iter < 1) {
+        return NULL;
+    }
+    n = points->rows;
+    d = points->cols;
+    centroids = initialize_matrix_with_zeros(k, d);
+    new_centroids = initialize_matrix_with_zeros(k, d);
+    assignment = labels != NULL ? labels : (int *)malloc((size_t)n * sizeof(int));
+    if (centroids == NULL || new_centroids == NULL || assignment == NULL
+        || !allocate_kmeans_state(&state, n, k, d, options->algorithm)) {
+        free_matrix(centroids);
+        free_matrix(new_centroids);
+        if (assignment != labels) {
+            free(assignment);
+        }
+        return NULL;
+    }
+    for (i = 0; i < k; i++) {
+        memcpy(MATRIX_ROW(centroids, i), MATRIX_ROW(points, i), (size_t)d * sizeof(double));
+    }
+    for (iteration = 0; iteration < options->max_iter; iteration++) {
+        assign_points(&state, points, centroids, assignment);
+        update_centroids(&state, new_centroids);
+        /* The centroids of the last assignment are the ones returned, like the labels */
+        if (centroids_converged(&state, centroids, new_centroids, options->eps) || iteration == options->max_iter - 1) {
+            break;
+        }
+        state.bounded = state.algorithm != KMEANS_LLOYD;
+        swap = centroids;
+        centroids = new_centroids;
+        new_centroids = swap;
+    }
+    free_kmeans_state(&state);
+    free_matrix(new_centroids);
+    if (assignment != labels) {
+        free(assignment);
+    }
+    return centroids;
+}
+
+/* Helper function to add the part sums of a batch to the sums and counts of an epoch, in part order */
+static void accumulate_batch(KmeansState *state, double *sums, long *counts) {
+    int k = state->k, d = state->d, part, cluster, c;
+    const double *part_sum;
+    for (part = 0; part < state->parts; part++) {
+        for (cluster = 0; cluster < k; cluster++) {
+            counts[cluster] += state->part_counts[(size_t)part * k + cluster];
+            part_sum = state->part_sums + ((size_t)part * k + cluster) * d;
+            for (c = 0; c < d; c++) {
+                sums[(size_t)cluster * d + c] += part_sum[c];
+            }
+        }
+    }
+}
+
+/* Helper function to run one epoch of mini-batch k-means, moving centroids from the centroids
+ * at the start of the epoch. Returns the number of points read, or -1 on failure. */
+static long minibatch_epoch(KmeansState *state, MatrixReader *reader, Matrix *batch, int capacity,
+                            int *batch_labels, double *sums, long *counts, Matrix *centroids, long *error_line) {
+    int k = state->k, d = state->d, cluster, c, count;
+    long total = 0;
+    double *row;
+    memset(sums, 0, (size_t)k * d * sizeof(double));
+    memset(counts, 0, (size_t)k * sizeof(long));
+    if (!rewind_matrix_reader(reader)) {
+        return -1;
+    }
+    while ((count = read_matrix_rows(reader, batch, capacity, error_line)) > 0) {
+        batch->rows = count;
+        assign_points(state, batch, centroids, batch_labels);
+        accumulate_batch(state, sums, counts);
+        for (cluster = 0; cluster < k; cluster++) {
+            row = MATRIX_ROW(centroids, cluster);
+            for (c = 0; c < d && counts[cluster] != 0; c++) {
+                row[c] = sums[(size_t)cluster * d + c] / counts[cluster];
+            }
+        }
+        total += count;
+    }
+    batch->rows = capacity;
+    if (count < 0) {
+        return -1;
+    }
+    for (cluster = 0; cluster < k; cluster++) {
+        if (counts[cluster] == 0) {
+            memset(MATRIX_ROW(centroids, cluster), 0, (size_t)d * sizeof(double));
+        }
+    }
+    return total;
+}
+
+/* Function to run mini-batch k-means over a matrix file in bounded memory */
+Matrix* minibatch_kmeans(MatrixReader *reader, int k, const KmeansOptions *options, long *rows, long *error_line) {
+    int d, capacity, i, iteration, count, *batch_labels;
+    long total = 0, *counts;
+    double *sums;
+    Matrix *batch, *centroids, *new_centroids, *swap;
+    KmeansState state;
+    *error_line = 0;
+    if (reader == NULL || k < 1 || options->max_iter < 1 || options->batch_size < 1) {
+        return NULL;
+    }
+    d = reader->cols;
+    capacity = options->batch_size < k ? k : options->batch_size;
+    batch = initialize_matrix_with_zeros(capacity, d);
+    centroids = initialize_matrix_with_zeros(k, d);
+    new_centroids = initialize_matrix_with_zeros(k, d);
+    batch_labels = (int *)malloc((size_t)capacity * sizeof(int));
+    sums = allocate_matrix_data(k, d);
+    counts = (long *)calloc((size_t)k, sizeof(long));
+    if (batch == NULL || centroids == NULL || new_centroids == NULL || batch_labels == NULL || sums == NULL
+        || counts == NULL || !allocate_kmeans_state(&state, capacity, k, d, KMEANS_LLOYD)) {
+        free_matrix(batch);
+        free_matrix(centroids);
+        free_matrix(new_centroids);
+        free(batch_labels);
+        free(sums);
+        free(counts);
+        return NULL;
+    }
+    /* The first batch holds the k initial centroids, unless the file has fewer points */
+    count = rewind_matrix_reader(reader) ? read_matrix_rows(reader, batch, capacity, error_line) : -1;
+    if (count >= k) {
+        for (i = 0; i < k; i++) {
+            memcpy(MATRIX_ROW(centroids, i), MATRIX_ROW(batch, i), (size_t)d * sizeof(double));
+        }
+        for (iteration = 0; iteration < options->max_iter; iteration++) {
+            for (i = 0; i < k; i++) {
+                memcpy(MATRIX_ROW(new_centroids, i), MATRIX_ROW(centroids, i), (size_t)d * sizeof(double));
+            }
+            total = minibatch_epoch(&state, reader, batch, capacity, batch_labels, sums, counts, new_centroids,
+                                    error_line);
+            if (total < 0 || centroids_converged(&state, centroids, new_centroids, options->eps)
+                || iteration == options->max_iter - 1) {
+                break;
+            }
+            swap = centroids;
+            centroids = new_centroids;
+            new_centroids = swap;
+        }
+    }
+    free_kmeans_state(&state);
+    free_matrix(batch);
+    free_matrix(new_centroids);
+    free(batch_labels);
+    free(sums);
+    free(counts);
+    if (count < k || total <= k) {
+        free_matrix(centroids);
+        return NULL;
+    }
+    *rows = total;
+    return centroids;
+}
+
+/* Function to label every point of a matrix file with its nearest centroid, a batch at a time */
+int label_matrix_rows(MatrixReader *reader, Matrix *centroids, int batch_size, int *labels, long capacity,
+                      long *error_line) {
+    int count;
+    long total = 0;
+    Matrix *batch;
+    KmeansState state;
+    *error_line = 0;
+    if (reader == NULL || centroids == NULL || centroids->cols != reader->cols || batch_size < 1) {
+        return 0;
+    }
+    batch = initialize_matrix_with_zeros(batch_size, reader->cols);
+    if (batch == NULL || !allocate_kmeans_state(&state, batch_size, centroids->rows, reader->cols, KMEANS_LLOYD)) {
+        free_matrix(batch);
+        return 0;
+    }
+    count = rewind_matrix_reader(reader) ? 1 : -1;
+    while (count > 0 && (count = read_matrix_rows(reader, batch, batch_size, error_line)) > 0) {
+        if (total + count > capacity) {
+            /* The file grew since the pass that sized labels */
+            count = -1;
+            break;
+        }
+        batch->rows = count;
+        assign_points(&state, batch, centroids, labels + total);
+        total += count;
+    }
+    batch->rows = batch_size;
+    free_kmeans_state(&state);
+    free_matrix(batch);
+    return count == 0 && total == capacity;
+}
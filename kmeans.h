@@ -0,0 +1,84 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include "symnmf.h"
+#include "matrixio.h"
+
+/* Default stopping rule of kmeans.py: at most KMEANS_MAX_ITER iterations, or until no centroid
+ * moves by KMEANS_EPS or more (Euclidean distance) */
+#define KMEANS_MAX_ITER 300
+#define KMEANS_EPS 0.0001
+
+/* Number of contiguous parts the points are split into for the centroid sums. Each part is
+ * summed in point order and the parts are added in order, so the centroids do not depend on
+ * the number of threads. */
+#define KMEANS_PARTS 64
+
+/* Default number of points per batch of minibatch_kmeans */
+#define KMEANS_BATCH_SIZE 4096
+
+/* Assignment step of the k-means iterations. All of them give exactly the labels and centroids
+ * of KMEANS_LLOYD; the bounded ones skip the distances that cannot change a label.
+ * KMEANS_LLOYD: every point is compared with every centroid.
+ * KMEANS_HAMERLY: one upper bound per point on the distance to its centroid and one lower bound
+ *                 on the distance to every other centroid; O(n) extra memory.
+ * KMEANS_ELKAN: a lower bound per point and centroid, plus the distances between centroids;
+ *               O(nk) extra memory, fewer distances when k is large.
+ * KMEANS_AUTO: Hamerly for k below KMEANS_ELKAN_MIN_K, Elkan from there on. */
+typedef enum KmeansAlgorithm {
+    KMEANS_LLOYD,
+    KMEANS_HAMERLY,
+    KMEANS_ELKAN,
+    KMEANS_AUTO
+} KmeansAlgorithm;
+
+/* Number of clusters from which KMEANS_AUTO prefers Elkan's bounds to Hamerly's */
+#define KMEANS_ELKAN_MIN_K 128
+
+/* Relative slack by which the bounds are loosened at every update. A centroid is skipped only
+ * when the bounds prove it farther than the assigned one by more than the rounding error of the
+ * distance kernel, about d * 2^-53 relative, so ties are broken exactly as in KMEANS_LLOYD. */
+#define KMEANS_BOUND_SLACK 1e-9
+
+/* Options of the k-means iterations */
+typedef struct KmeansOptions {
+    KmeansAlgorithm algorithm;
+    int max_iter;       /* at least 1 */
+    double eps;
+    int batch_size;     /* points per batch of minibatch_kmeans */
+} KmeansOptions;
+
+/* Fills options with the defaults of kmeans.py */
+void default_kmeans_options(KmeansOptions *options);
+
+/* Parses "lloyd", "hamerly", "elkan" or "auto"; returns 1 on success and 0 for an unknown name */
+int kmeans_algorithm_from_name(const char *name, KmeansAlgorithm *algorithm);
+
+/* Runs Lloyd's k-means on the rows of points, starting from the first k points as centroids
+ * (1 <= k < n) like kmeans.py. Every iteration assigns each point to its nearest centroid, the
+ * first one on ties, with the assignment step of options->algorithm, and moves each centroid to
+ * the mean of its points; a centroid without points moves to the origin. The iterations stop
+ * after options->max_iter of them, or once no centroid moved by options->eps or more. labels,
+ * if not NULL, receives the cluster of every point from the last assignment; the centroids that
+ * assignment used are returned. */
+Matrix* kmeans(Matrix *points, int k, const KmeansOptions *options, int *labels);
+
+/* Runs mini-batch k-means on the rows of a matrix file, holding one batch of options->batch_size
+ * points (at least k) in memory at a time. The first k points are the initial centroids. Every
+ * epoch reads the file once, batch by batch: each batch is assigned to the current centroids
+ * (always exhaustively), and every centroid that received points moves to the mean of all the
+ * points assigned to it so far in the epoch. A centroid left without points at the end of an
+ * epoch moves to the origin. Epochs stop like the iterations of kmeans, on options->max_iter and
+ * options->eps. With a batch of all n points an epoch is an iteration of kmeans and the result is
+ * identical. *rows receives n. Returns the centroids the epochs stopped at, or NULL, with
+ * *error_line set as by read_matrix_rows. */
+Matrix* minibatch_kmeans(MatrixReader *reader, int k, const KmeansOptions *options, long *rows, long *error_line);
+
+/* Stores in labels the nearest centroid of every point of a matrix file, the first on ties,
+ * reading batch_size points at a time. labels has room for capacity points, the number of rows
+ * an earlier pass over the file found. Returns 1 on success and 0 on failure, including when
+ * the file no longer has exactly capacity rows. */
+int label_matrix_rows(MatrixReader *reader, Matrix *centroids, int batch_size, int *labels, long capacity,
+                      long *error_line);
+
+#endif
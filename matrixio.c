@@ -0,0 +1,862 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "matrixio.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Largest number of significant digits converted without strtod: they must fit both the
+ * unsigned long they are accumulated in and, exactly, a double (10^15 < 2^53) */
+#define FAST_MAX_DIGITS (sizeof(unsigned long) >= 8 ? 15 : 9)
+/* Largest power of ten a double holds exactly */
+#define FAST_MAX_EXPONENT 22
+/* Smallest share of the text worth handing to a thread of its own */
+#define CSV_MIN_CHUNK (1 << 20)
+/* Values at or beyond this many ten-thousandths are formatted by sprintf: the rounded
+ * value must fit an unsigned long, and a double must hold every integer below it */
+#define FIXED4_FAST_LIMIT (sizeof(unsigned long) >= 8 ? 1e15 : 4e9)
+/* Bytes requested per read() when a file cannot be mapped */
+#define READ_CHUNK (1 << 20)
+
+static const double powers_of_ten[FAST_MAX_EXPONENT + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Helper function to tell whether a character may surround a value */
+static int is_blank(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+/* Helper function to convert a number with strtod, copying it out since the text is not terminated */
+static const char* scan_double_slow(const char *text, const char *end, double *value) {
+    char token[CSV_MAX_TOKEN];
+    char *stop;
+    size_t length = 0;
+    while (text + length < end && length < CSV_MAX_TOKEN - 1 && text[length] != ','
+           && text[length] != '\n' && !is_blank(text[length])) {
+        token[length] = text[length];
+        length++;
+    }
+    token[length] = '\0';
+    *value = strtod(token, &stop);
+    return stop == token ? NULL : text + (stop - token);
+}
+
+/* Function to convert one number, exactly and without strtod in the common case */
+const char* scan_double(const char *text, const char *end, double *value) {
+    const char *p = text;
+    unsigned long mantissa = 0;
+    double result;
+    int negative = 0, digits = 0, significant = 0, exponent = 0, exponent_value = 0, exponent_negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (significant > 0 || *p != '0') {
+            mantissa = mantissa * 10 + (unsigned long)(*p - '0');
+            significant++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (significant > 0 || *p != '0') {
+                mantissa = mantissa * 10 + (unsigned long)(*p - '0');
+                significant++;
+            }
+            exponent--;
+        }
+    }
+    if (digits == 0 || (p < end && (*p == 'x' || *p == 'X'))) {
+        /* inf, nan, hexadecimal or no number at all */
+        return scan_double_slow(text, end, value);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponent_negative = *p == '-';
+            p++;
+        }
+        if (p >= end || *p < '0' || *p > '9') {
+            return scan_double_slow(text, end, value);
+        }
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (exponent_value < 10000) {
+                exponent_value = exponent_value * 10 + (*p - '0');
+            }
+        }
+        exponent += exponent_negative ? -exponent_value : exponent_value;
+    }
+    if (significant > (int)FAST_MAX_DIGITS || exponent > FAST_MAX_EXPONENT || exponent < -FAST_MAX_EXPONENT) {
+        return scan_double_slow(text, end, value);
+    }
+    /* Both operands are exact, so the single rounding of * or / gives the correctly rounded value */
+    result = (double)mantissa;
+    result = exponent < 0 ? result / powers_of_ten[-exponent] : result * powers_of_ten[exponent];
+    *value = negative ? -result : result;
+    return p;
+}
+
+/* Helper function to find the end of the line starting at p */
+static const char* line_end_of(const char *p, const char *end) {
+    const char *line_end = (const char *)memchr(p, '\n', (size_t)(end - p));
+    return line_end == NULL ? end : line_end;
+}
+
+/* Helper function to skip the blanks at p, stopping at line_end */
+static const char* skip_blanks(const char *p, const char *line_end) {
+    while (p < line_end && is_blank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Helper function to count the values on the first non-blank line */
+static int count_columns(const char *p, const char *end) {
+    int cols = 1;
+    for (; p < end && *p != '\n'; p++) {
+        if (*p == ',') {
+            cols++;
+        }
+    }
+    return cols;
+}
+
+/* Helper function to find where chunk c of chunks starts: the first line start at or after
+ * its share of the text, so that no line is split between two chunks */
+static size_t chunk_start(const char *text, size_t length, int c, int chunks) {
+    size_t position;
+    const char *newline;
+    if (c == 0 || c == chunks) {
+        return c == 0 ? 0 : length;
+    }
+    position = (size_t)((double)length * c / chunks);
+    if (position == 0) {
+        return 0;
+    }
+    newline = (const char *)memchr(text + position - 1, '\n', length - position + 1);
+    return newline == NULL ? length : (size_t)(newline - text) + 1;
+}
+
+/* Helper function to count the lines and the non-blank lines (rows) of a chunk */
+static void count_lines(const char *p, const char *end, long *lines, long *rows) {
+    const char *line_end;
+    *lines = 0;
+    *rows = 0;
+    for (; p < end; p = line_end + 1) {
+        line_end = line_end_of(p, end);
+        (*lines)++;
+        if (skip_blanks(p, line_end) < line_end) {
+            (*rows)++;
+        }
+    }
+}
+
+/* Helper function to parse the rows of a chunk into the matrix from row first_row on.
+ * Returns 0 on success, or the line number of the first malformed row. */
+static long parse_rows(const char *p, const char *end, long first_line, Matrix *matrix, long first_row) {
+    const char *line_end;
+    long line = first_line - 1, row_index = first_row;
+    int j, cols = matrix->cols;
+    double *row;
+    for (; p < end; p = line_end + 1) {
+        line++;
+        line_end = line_end_of(p, end);
+        p = skip_blanks(p, line_end);
+        if (p == line_end) {
+            continue;
+        }
+        row = MATRIX_ROW(matrix, row_index);
+        for (j = 0; j < cols; j++) {
+            p = scan_double(skip_blanks(p, line_end), line_end, &row[j]);
+            if (p == NULL) {
+                return line;
+            }
+            p = skip_blanks(p, line_end);
+            if (j < cols - 1 ? (p == line_end || *p != ',') : p != line_end) {
+                return line;
+            }
+            p++;
+        }
+        row_index++;
+    }
+    return 0;
+}
+
+/* Function to parse CSV text into a matrix, one chunk of whole lines per thread */
+Matrix* parse_csv(const char *text, size_t length, long *error_line) {
+    const char *first, *first_end;
+    int chunks, c;
+    long *lines, *rows, *errors;
+    size_t *starts;
+    Matrix *matrix = NULL;
+    *error_line = 0;
+    /* The first non-blank line fixes the number of columns */
+    for (first = text; first < text + length; first = first_end + 1) {
+        first_end = line_end_of(first, text + length);
+        if (skip_blanks(first, first_end) < first_end) {
+            break;
+        }
+    }
+    if (first >= text + length) {
+        return NULL;
+    }
+    chunks = 1;
+#ifdef _OPENMP
+    chunks = omp_get_max_threads();
+#endif
+    if ((size_t)chunks > length / CSV_MIN_CHUNK + 1) {
+        chunks = (int)(length / CSV_MIN_CHUNK + 1);
+    }
+    starts = (size_t *)malloc(((size_t)chunks + 1) * sizeof(size_t));
+    lines = (long *)calloc((size_t)chunks + 1, sizeof(long));
+    rows = (long *)calloc((size_t)chunks + 1, sizeof(long));
+    errors = (long *)calloc((size_t)chunks, sizeof(long));
+    if (starts != NULL && lines != NULL && rows != NULL && errors != NULL) {
+        for (c = 0; c <= chunks; c++) {
+            starts[c] = chunk_start(text, length, c, chunks);
+        }
+        #pragma omp parallel for schedule(static, 1) num_threads(chunks)
+        for (c = 0; c < chunks; c++) {
+            count_lines(text + starts[c], text + starts[c + 1], &lines[c + 1], &rows[c + 1]);
+        }
+        /* Prefix sums give every chunk its first line number and its first row in the matrix */
+        lines[0] = 1;
+        for (c = 0; c < chunks; c++) {
+            lines[c + 1] += lines[c];
+            rows[c + 1] += rows[c];
+        }
+        if (rows[chunks] <= INT_MAX) {
+            matrix = initialize_matrix_with_zeros((int)rows[chunks], count_columns(first, text + length));
+        }
+    }
+    if (matrix != NULL) {
+        #pragma omp parallel for schedule(static, 1) num_threads(chunks)
+        for (c = 0; c < chunks; c++) {
+            errors[c] = parse_rows(text + starts[c], text + starts[c + 1], lines[c], matrix, rows[c]);
+        }
+        for (c = 0; c < chunks; c++) {
+            if (errors[c] != 0) {
+                *error_line = errors[c];
+                free_matrix(matrix);
+                matrix = NULL;
+                break;
+            }
+        }
+    }
+    free(starts);
+    free(lines);
+    free(rows);
+    free(errors);
+    return matrix;
+}
+
+/* Helper function to read a file that cannot be mapped, such as a pipe, into a growing buffer */
+static char* read_whole_file(int fd, size_t *length) {
+    size_t capacity = READ_CHUNK, size = 0;
+    ssize_t got;
+    char *buffer = (char *)malloc(capacity), *grown;
+    while (buffer != NULL) {
+        if (capacity - size < READ_CHUNK / 2) {
+            grown = (char *)realloc(buffer, capacity * 2);
+            if (grown == NULL) {
+                break;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        got = read(fd, buffer + size, capacity - size);
+        if (got <= 0) {
+            if (got == 0) {
+                *length = size;
+                return buffer;
+            }
+            break;
+        }
+        size += (size_t)got;
+    }
+    free(buffer);
+    return NULL;
+}
+
+/* Function to load a CSV file through mmap, or read() when it cannot be mapped */
+Matrix* read_csv_file(const char *file_name, long *error_line) {
+    int fd;
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    char *buffer = NULL;
+    size_t length = 0;
+    Matrix *matrix = NULL;
+    *error_line = 0;
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        length = (size_t)info.st_size;
+        mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (mapped != MAP_FAILED) {
+        posix_madvise(mapped, length, POSIX_MADV_SEQUENTIAL);
+        matrix = parse_csv((const char *)mapped, length, error_line);
+        munmap(mapped, length);
+    } else {
+        buffer = read_whole_file(fd, &length);
+        if (buffer != NULL) {
+            matrix = parse_csv(buffer, length, error_line);
+            free(buffer);
+        }
+    }
+    close(fd);
+    return matrix;
+}
+
+/* Function to format a value with four decimals, without printf in the common case */
+int format_fixed4(double value, char *out) {
+    char digits[24];
+    double magnitude, scaled, whole, fraction, bound;
+    unsigned long rounded, decimals;
+    int negative, length = 0, count = 0, i;
+    negative = value < 0 || (value == 0 && 1.0 / value < 0);
+    magnitude = negative ? -value : value;
+    scaled = magnitude * 10000.0;
+    if (!(scaled < FIXED4_FAST_LIMIT)) {
+        return sprintf(out, "%.4f", value);
+    }
+    /* scaled is within half an ulp (at most scaled * 2^-53) of the exact magnitude * 10^4, so
+     * unless its fraction is that close to one half it rounds the same way printf does */
+    whole = floor(scaled);
+    fraction = scaled - whole;
+    bound = scaled * DBL_EPSILON;
+    if (fraction - 0.5 <= bound && 0.5 - fraction <= bound) {
+        return sprintf(out, "%.4f", value);
+    }
+    rounded = (unsigned long)whole + (fraction > 0.5 ? 1 : 0);
+    if (negative) {
+        out[length++] = '-';
+    }
+    decimals = rounded % 10000;
+    rounded /= 10000;
+    do {
+        digits[count++] = (char)('0' + rounded % 10);
+        rounded /= 10;
+    } while (rounded > 0);
+    for (i = count - 1; i >= 0; i--) {
+        out[length++] = digits[i];
+    }
+    out[length++] = '.';
+    for (i = 3; i >= 0; i--) {
+        out[length + i] = (char)('0' + decimals % 10);
+        decimals /= 10;
+    }
+    return length + 4;
+}
+
+/* Growable text buffer holding one rendered block of rows */
+typedef struct TextBlock {
+    char *text;
+    size_t length;
+    size_t capacity;
+} TextBlock;
+
+/* Helper function to render rows [first, last) of a matrix into a block */
+static int render_rows(Matrix *matrix, int first, int last, TextBlock *block) {
+    int i, j;
+    char *grown;
+    double *row;
+    block->length = 0;
+    for (i = first; i < last; i++) {
+        row = MATRIX_ROW(matrix, i);
+        for (j = 0; j < matrix->cols; j++) {
+            if (block->capacity - block->length < FIXED4_MAX_CHARS + 1) {
+                grown = (char *)realloc(block->text, block->capacity * 2 + FIXED4_MAX_CHARS + 1);
+                if (grown == NULL) {
+                    return 0;
+                }
+                block->text = grown;
+                block->capacity = block->capacity * 2 + FIXED4_MAX_CHARS + 1;
+            }
+            block->length += (size_t)format_fixed4(row[j], block->text + block->length);
+            block->text[block->length++] = j < matrix->cols - 1 ? ',' : '\n';
+        }
+    }
+    return 1;
+}
+
+/* Function to write a matrix as text, a group of blocks of rows at a time */
+int write_matrix_text(Matrix *matrix, FILE *file) {
+    int threads = 1, block_rows, blocks, group, b, first, last, failed = 0;
+    TextBlock *buffers;
+    if (matrix->rows == 0 || matrix->cols == 0) {
+        return 1;
+    }
+    block_rows = TEXT_BLOCK_VALUES / matrix->cols > 0 ? TEXT_BLOCK_VALUES / matrix->cols : 1;
+    blocks = (matrix->rows + block_rows - 1) / block_rows;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (threads > blocks) {
+        threads = blocks;
+    }
+    buffers = (TextBlock *)calloc((size_t)threads, sizeof(TextBlock));
+    if (buffers == NULL) {
+        return 0;
+    }
+    for (group = 0; group < blocks && !failed; group += threads) {
+        /* Render up to one block per thread, then write the blocks out in order */
+        #pragma omp parallel for schedule(static, 1) num_threads(threads) private(first, last)
+        for (b = 0; b < threads; b++) {
+            first = (group + b) * block_rows;
+            last = first + block_rows < matrix->rows ? first + block_rows : matrix->rows;
+            buffers[b].length = 0;
+            if (group + b < blocks && !render_rows(matrix, first, last, &buffers[b])) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        for (b = 0; b < threads && !failed && group + b < blocks; b++) {
+            if (fwrite(buffers[b].text, 1, buffers[b].length, file) != buffers[b].length) {
+                failed = 1;
+            }
+        }
+    }
+    for (b = 0; b < threads; b++) {
+        free(buffers[b].text);
+    }
+    free(buffers);
+    return !failed;
+}
+
+/* Running checksum of a binary matrix file's data */
+typedef struct MatrixChecksum {
+    unsigned long a;
+    unsigned long b;
+} MatrixChecksum;
+
+/* Helper function to tell whether doubles are stored little-endian on this host */
+static int host_is_little_endian(void) {
+    unsigned int one = 1;
+    return *(unsigned char *)&one == 1;
+}
+
+/* Helper function to store the low 32 bits of value little-endian */
+static void put_u32(unsigned char *out, unsigned long value) {
+    int i;
+    for (i = 0; i < 4; i++, value >>= 8) {
+        out[i] = (unsigned char)(value & 0xFF);
+    }
+}
+
+/* Helper function to store value as a 64-bit little-endian integer */
+static void put_u64(unsigned char *out, size_t value) {
+    int i;
+    for (i = 0; i < 8; i++, value >>= 8) {
+        out[i] = (unsigned char)(value & 0xFF);
+    }
+}
+
+/* Helper function to read a 32-bit little-endian integer */
+static unsigned long get_u32(const unsigned char *in) {
+    return (unsigned long)in[0] | ((unsigned long)in[1] << 8) | ((unsigned long)in[2] << 16)
+           | ((unsigned long)in[3] << 24);
+}
+
+/* Helper function to read a 64-bit little-endian integer; returns 0 if it does not fit a size_t */
+static int get_u64(const unsigned char *in, size_t *value) {
+    int i;
+    *value = 0;
+    for (i = 7; i >= 0; i--) {
+        if (i >= (int)sizeof(size_t) && in[i] != 0) {
+            return 0;
+        }
+        if (i < (int)sizeof(size_t)) {
+            *value = (*value << 8) | in[i];
+        }
+    }
+    return 1;
+}
+
+/* Helper function to add length bytes (a multiple of 4) of stored data to a checksum */
+static void update_checksum(MatrixChecksum *checksum, const unsigned char *bytes, size_t length) {
+    unsigned long a = checksum->a, b = checksum->b;
+    size_t i;
+    for (i = 0; i + 4 <= length; i += 4) {
+        a += get_u32(bytes + i);
+        b += a;
+    }
+    checksum->a = a & 0xFFFFFFFFUL;
+    checksum->b = b & 0xFFFFFFFFUL;
+}
+
+/* Helper function to lay out one row as stored in a file: stride little-endian doubles, zero padded */
+static void encode_row(const double *row, int cols, int stride, unsigned char *out) {
+    int j, byte;
+    const unsigned char *value;
+    memset(out, 0, (size_t)stride * sizeof(double));
+    if (host_is_little_endian()) {
+        memcpy(out, row, (size_t)cols * sizeof(double));
+        return;
+    }
+    for (j = 0; j < cols; j++) {
+        value = (const unsigned char *)&row[j];
+        for (byte = 0; byte < (int)sizeof(double); byte++) {
+            out[j * sizeof(double) + byte] = value[sizeof(double) - 1 - byte];
+        }
+    }
+}
+
+/* Helper function to decode cols stored little-endian doubles into row */
+static void decode_row(const unsigned char *in, int cols, double *row) {
+    int j, byte;
+    unsigned char *value;
+    if (host_is_little_endian()) {
+        memcpy(row, in, (size_t)cols * sizeof(double));
+        return;
+    }
+    for (j = 0; j < cols; j++) {
+        value = (unsigned char *)&row[j];
+        for (byte = 0; byte < (int)sizeof(double); byte++) {
+            value[byte] = in[j * sizeof(double) + sizeof(double) - 1 - byte];
+        }
+    }
+}
+
+/* Function to write a matrix in the binary matrix format */
+int write_matrix_binary(Matrix *matrix, const char *file_name) {
+    unsigned char header[MATRIX_FILE_HEADER], *row;
+    int i, stride, ok;
+    size_t row_bytes;
+    MatrixChecksum checksum;
+    FILE *file;
+    stride = matrix_stride(matrix->cols);
+    row_bytes = (size_t)stride * sizeof(double);
+    row = (unsigned char *)malloc(row_bytes > 0 ? row_bytes : 1);
+    if (row == NULL) {
+        return 0;
+    }
+    checksum.a = 0;
+    checksum.b = 0;
+    for (i = 0; i < matrix->rows; i++) {
+        encode_row(MATRIX_ROW(matrix, i), matrix->cols, stride, row);
+        update_checksum(&checksum, row, row_bytes);
+    }
+    memset(header, 0, sizeof(header));
+    memcpy(header, MATRIX_FILE_MAGIC, 8);
+    put_u32(header + 8, MATRIX_FILE_VERSION);
+    put_u32(header + 12, MATRIX_FILE_FLOAT64);
+    put_u64(header + 16, (size_t)matrix->rows);
+    put_u64(header + 24, (size_t)matrix->cols);
+    put_u64(header + 32, (size_t)stride);
+    put_u32(header + 40, checksum.a);
+    put_u32(header + 44, checksum.b);
+    file = fopen(file_name, "wb");
+    if (file == NULL) {
+        free(row);
+        return 0;
+    }
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (i = 0; ok && i < matrix->rows; i++) {
+        encode_row(MATRIX_ROW(matrix, i), matrix->cols, stride, row);
+        ok = fwrite(row, 1, row_bytes, file) == row_bytes;
+    }
+    free(row);
+    return fclose(file) == 0 && ok;
+}
+
+/* Helper function to allocate the Matrix of a mapped file; its data starts right after the header */
+static Matrix* wrap_mapping(void *mapping, size_t length, int rows, int cols, int stride) {
+    Matrix *matrix = (Matrix *)malloc(sizeof(Matrix));
+    if (matrix == NULL) {
+        return NULL;
+    }
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = stride;
+    matrix->data = (double *)((char *)mapping + MATRIX_FILE_HEADER);
+    matrix->mapping = mapping;
+    matrix->mapping_length = length;
+    return matrix;
+}
+
+/* Helper function to copy the stored rows of a mapped file into a freshly allocated matrix */
+static Matrix* copy_mapping(const unsigned char *data, int rows, int cols, size_t stored_stride) {
+    int i;
+    Matrix *matrix = initialize_matrix_with_zeros(rows, cols);
+    if (matrix == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < rows; i++) {
+        decode_row(data + (size_t)i * stored_stride * sizeof(double), cols, MATRIX_ROW(matrix, i));
+    }
+    return matrix;
+}
+
+/* Function to load a binary matrix file, mapping it in place when its layout allows */
+Matrix* read_matrix_binary(const char *file_name, int verify) {
+    int fd;
+    struct stat info;
+    size_t rows, cols, stride, length;
+    unsigned char *mapping;
+    MatrixChecksum checksum;
+    Matrix *matrix = NULL;
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < MATRIX_FILE_HEADER) {
+        close(fd);
+        return NULL;
+    }
+    length = (size_t)info.st_size;
+    /* A private writable mapping: the pages are shared with the page cache until written to */
+    mapping = (unsigned char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ((void *)mapping == MAP_FAILED) {
+        return NULL;
+    }
+    if (memcmp(mapping, MATRIX_FILE_MAGIC, 8) != 0 || get_u32(mapping + 8) != MATRIX_FILE_VERSION
+        || get_u32(mapping + 12) != MATRIX_FILE_FLOAT64 || !get_u64(mapping + 16, &rows)
+        || !get_u64(mapping + 24, &cols) || !get_u64(mapping + 32, &stride) || rows > INT_MAX
+        || cols > INT_MAX || stride < cols || (rows > 0 && stride > (length - MATRIX_FILE_HEADER) / sizeof(double) / rows)
+        || length != MATRIX_FILE_HEADER + rows * stride * sizeof(double)) {
+        munmap(mapping, length);
+        return NULL;
+    }
+    if (verify) {
+        posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+        checksum.a = 0;
+        checksum.b = 0;
+        update_checksum(&checksum, mapping + MATRIX_FILE_HEADER, length - MATRIX_FILE_HEADER);
+        if (checksum.a != get_u32(mapping + 40) || checksum.b != get_u32(mapping + 44)) {
+            munmap(mapping, length);
+            return NULL;
+        }
+    }
+    if (host_is_little_endian() && stride == (size_t)matrix_stride((int)cols)) {
+        matrix = wrap_mapping(mapping, length, (int)rows, (int)cols, (int)stride);
+        if (matrix != NULL) {
+            return matrix;
+        }
+    } else {
+        matrix = copy_mapping(mapping + MATRIX_FILE_HEADER, (int)rows, (int)cols, stride);
+    }
+    munmap(mapping, length);
+    return matrix;
+}
+
+/* Function to load a matrix file of either format */
+Matrix* read_matrix_file(const char *file_name, int verify, long *error_line) {
+    char magic[8];
+    size_t got = 0;
+    struct stat info;
+    FILE *file;
+    *error_line = 0;
+    /* Only regular files are peeked at: reading the magic from a pipe would consume it */
+    if (stat(file_name, &info) == 0 && S_ISREG(info.st_mode)) {
+        file = fopen(file_name, "rb");
+        if (file == NULL) {
+            return NULL;
+        }
+        got = fread(magic, 1, sizeof(magic), file);
+        fclose(file);
+    }
+    if (got == sizeof(magic) && memcmp(magic, MATRIX_FILE_MAGIC, sizeof(magic)) == 0) {
+        return read_matrix_binary(file_name, verify);
+    }
+    return read_csv_file(file_name, error_line);
+}
+
+/* Function to release the mapping behind a matrix */
+void unmap_matrix_file(void *mapping, size_t length) {
+    munmap(mapping, length);
+}
+
+/* Function to move a reader back to the first row */
+int rewind_matrix_reader(MatrixReader *reader) {
+    reader->rows_read = 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->at_eof = 0;
+    reader->line = 0;
+    reader->checksum[0] = 0;
+    reader->checksum[1] = 0;
+    return fseek(reader->file, reader->binary ? MATRIX_FILE_HEADER : 0, SEEK_SET) == 0;
+}
+
+/* Function to close the file of a reader and free it */
+void close_matrix_reader(MatrixReader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+    free(reader->buffer);
+    free(reader->row);
+    free(reader);
+}
+
+/* Helper function to move the unparsed text to the start of the buffer and read more after it.
+ * Returns 0 when the file cannot be read or the buffer is full of a single line. */
+static int fill_reader(MatrixReader *reader) {
+    size_t wanted, got;
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    if (reader->end == READER_BUFFER) {
+        return 0;
+    }
+    wanted = READER_BUFFER - reader->end;
+    got = fread(reader->buffer + reader->end, 1, wanted, reader->file);
+    reader->end += got;
+    if (got < wanted) {
+        if (ferror(reader->file)) {
+            return 0;
+        }
+        reader->at_eof = 1;
+    }
+    return 1;
+}
+
+/* Helper function to take the next line of CSV text, reading more of the file when the line is
+ * incomplete. Returns 1 with the line in [*line, *line_end), 0 at the end of the file, or -1 when
+ * the file cannot be read or a line does not fit the buffer. */
+static int next_line(MatrixReader *reader, const char **line, const char **line_end) {
+    const char *newline;
+    for (;;) {
+        newline = (const char *)memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        if (newline != NULL || reader->at_eof) {
+            break;
+        }
+        if (!fill_reader(reader)) {
+            return -1;
+        }
+    }
+    if (newline == NULL && reader->start == reader->end) {
+        return 0;
+    }
+    *line = reader->buffer + reader->start;
+    *line_end = newline != NULL ? newline : reader->buffer + reader->end;
+    reader->start = (size_t)(*line_end - reader->buffer) + (newline != NULL ? 1 : 0);
+    reader->line++;
+    return 1;
+}
+
+/* Function to open a matrix file of either format for reading row by row */
+MatrixReader* open_matrix_reader(const char *file_name, long *error_line) {
+    unsigned char header[MATRIX_FILE_HEADER];
+    const char *line, *line_end;
+    size_t got, cols;
+    int status;
+    MatrixReader *reader;
+    *error_line = 0;
+    reader = (MatrixReader *)calloc(1, sizeof(MatrixReader));
+    if (reader == NULL) {
+        return NULL;
+    }
+    reader->file = fopen(file_name, "rb");
+    if (reader->file == NULL) {
+        free(reader);
+        return NULL;
+    }
+    got = fread(header, 1, sizeof(header), reader->file);
+    if (got >= 8 && memcmp(header, MATRIX_FILE_MAGIC, 8) == 0) {
+        reader->binary = 1;
+        if (got != sizeof(header) || get_u32(header + 8) != MATRIX_FILE_VERSION
+            || get_u32(header + 12) != MATRIX_FILE_FLOAT64 || !get_u64(header + 16, &reader->rows)
+            || !get_u64(header + 24, &cols) || !get_u64(header + 32, &reader->stride) || reader->rows > INT_MAX
+            || cols > INT_MAX || reader->stride < cols || reader->stride > ((size_t)-1) / sizeof(double)) {
+            close_matrix_reader(reader);
+            return NULL;
+        }
+        reader->cols = (int)cols;
+        reader->expected[0] = get_u32(header + 40);
+        reader->expected[1] = get_u32(header + 44);
+        reader->row = (unsigned char *)malloc(reader->stride > 0 ? reader->stride * sizeof(double) : 1);
+        if (reader->row == NULL || !rewind_matrix_reader(reader)) {
+            close_matrix_reader(reader);
+            return NULL;
+        }
+        return reader;
+    }
+    /* The first non-blank line fixes the number of columns */
+    reader->buffer = (char *)malloc(READER_BUFFER);
+    if (reader->buffer == NULL || !rewind_matrix_reader(reader)) {
+        close_matrix_reader(reader);
+        return NULL;
+    }
+    while ((status = next_line(reader, &line, &line_end)) == 1 && skip_blanks(line, line_end) == line_end) {
+    }
+    if (status != 1) {
+        close_matrix_reader(reader);
+        return NULL;
+    }
+    reader->cols = count_columns(line, line_end);
+    if (!rewind_matrix_reader(reader)) {
+        close_matrix_reader(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+/* Function to read the next rows of a matrix file into a block */
+int read_matrix_rows(MatrixReader *reader, Matrix *block, int max_rows, long *error_line) {
+    const char *line, *line_end;
+    size_t row_bytes;
+    int count = 0, status;
+    MatrixChecksum checksum;
+    *error_line = 0;
+    if (!reader->binary) {
+        while (count < max_rows) {
+            status = next_line(reader, &line, &line_end);
+            if (status <= 0) {
+                if (status < 0) {
+                    return -1;
+                }
+                break;
+            }
+            if (skip_blanks(line, line_end) == line_end) {
+                continue;
+            }
+            *error_line = parse_rows(line, line_end, reader->line, block, count);
+            if (*error_line != 0) {
+                return -1;
+            }
+            count++;
+        }
+        reader->rows_read += count;
+        return count;
+    }
+    row_bytes = reader->stride * sizeof(double);
+    checksum.a = reader->checksum[0];
+    checksum.b = reader->checksum[1];
+    while (count < max_rows && (size_t)reader->rows_read < reader->rows) {
+        if (fread(reader->row, 1, row_bytes, reader->file) != row_bytes) {
+            return -1;
+        }
+        update_checksum(&checksum, reader->row, row_bytes);
+        decode_row(reader->row, reader->cols, MATRIX_ROW(block, count));
+        reader->rows_read++;
+        count++;
+    }
+    reader->checksum[0] = checksum.a;
+    reader->checksum[1] = checksum.b;
+    if (count > 0 && (size_t)reader->rows_read == reader->rows
+        && (checksum.a != reader->expected[0] || checksum.b != reader->expected[1])) {
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,120 @@
+#ifndef MATRIXIO_H
+#define MATRIXIO_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "symnmf.h"
+
+/* Longest number (in characters) handed to strtod when the fast scanner cannot convert it */
+#define CSV_MAX_TOKEN 128
+
+/* Converts the number starting at text, reading no further than end, into *value.
+ * Decimal numbers with at most 15 significant digits and a decimal exponent within
+ * +-22 are converted exactly without strtod; everything else goes through strtod.
+ * Both are correctly rounded, so the result always equals what fscanf("%lf") reads.
+ * Returns a pointer just past the number, or NULL if there is no number at text. */
+const char* scan_double(const char *text, const char *end, double *value);
+
+/* Parses length bytes of comma-separated values into a matrix. The text is split at line
+ * boundaries into one chunk per thread; the chunks' lines are counted in parallel, a prefix
+ * sum places every chunk's rows in the matrix, and the chunks are then parsed in parallel.
+ * Every non-blank line is a row, and every row must have as many values as the first;
+ * spaces, tabs and carriage returns around values are ignored. On failure returns NULL and
+ * sets *error_line to the 1-based line number of the malformed row, or to 0 when the
+ * text is empty or memory runs out. */
+Matrix* parse_csv(const char *text, size_t length, long *error_line);
+
+/* Loads a CSV file, mapping it into memory when possible. Errors are reported as by parse_csv,
+ * with *error_line set to 0 when the file cannot be opened or read. */
+Matrix* read_csv_file(const char *file_name, long *error_line);
+
+/* Longest %.4f rendering of a double: sign, 309 integer digits, point and 4 decimals */
+#define FIXED4_MAX_CHARS 320
+
+/* Values per block of rows rendered by one thread before the block is written out */
+#define TEXT_BLOCK_VALUES (1 << 16)
+
+/* Writes value as printf("%.4f") would into out, which must hold FIXED4_MAX_CHARS bytes;
+ * returns the number of characters written. No terminating NUL is added. */
+int format_fixed4(double value, char *out);
+
+/* Writes a matrix as comma-separated %.4f rows, byte for byte like printf would, rendering
+ * blocks of rows in parallel and writing every block with a single fwrite.
+ * Returns 1 on success and 0 if a buffer cannot be allocated or the write fails. */
+int write_matrix_text(Matrix *matrix, FILE *file);
+
+/* Binary matrix files start with a MATRIX_FILE_HEADER-byte little-endian header:
+ *   bytes  0..7   magic "SYMNMFMX"
+ *   bytes  8..11  format version (MATRIX_FILE_VERSION)
+ *   bytes 12..15  element type (MATRIX_FILE_FLOAT64: IEEE 754 binary64)
+ *   bytes 16..23  rows
+ *   bytes 24..31  cols
+ *   bytes 32..39  stride, the stored row length in elements (>= cols, padding is zero)
+ *   bytes 40..47  checksum of the data: two 32-bit sums, a = sum of the data's 32-bit
+ *                 words and b = sum of the running values of a, both modulo 2^32
+ *   bytes 48..63  reserved, zero
+ * followed by rows * stride little-endian doubles. The header is one alignment unit long,
+ * so on a little-endian host the rows of a mapped file are as aligned as a Matrix's. */
+#define MATRIX_FILE_MAGIC "SYMNMFMX"
+#define MATRIX_FILE_HEADER 64
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_FLOAT64 1
+
+/* Writes a matrix to a binary matrix file; returns 1 on success and 0 on failure */
+int write_matrix_binary(Matrix *matrix, const char *file_name);
+
+/* Loads a binary matrix file after checking its header and, unless verify is 0, its checksum.
+ * When the stored layout is the in-memory one, the file is mapped and the matrix points into it
+ * without a copy. The checksum covers every stored byte, so a verified load is O(size) even when
+ * nothing is copied. With verify 0 a mapped file loads in O(1) and its pages are read when the
+ * data is first used, but a corrupted file goes undetected. */
+Matrix* read_matrix_binary(const char *file_name, int verify);
+
+/* Loads a matrix from a binary matrix file or a CSV file, telling them apart by the magic.
+ * verify is passed on to read_matrix_binary. CSV errors are reported through *error_line as
+ * by read_csv_file. */
+Matrix* read_matrix_file(const char *file_name, int verify, long *error_line);
+
+/* Releases the file mapping of a matrix loaded by read_matrix_binary */
+void unmap_matrix_file(void *mapping, size_t length);
+
+/* Bytes of CSV text a MatrixReader buffers; every line must fit in it */
+#define READER_BUFFER (1 << 22)
+
+/* Sequential reader of the rows of a CSV or binary matrix file that never holds more than
+ * READER_BUFFER bytes of text or one stored row, for data sets that do not fit in memory.
+ * The file must be seekable so that it can be read more than once. */
+typedef struct MatrixReader {
+    FILE *file;
+    int binary;             /* 1 for a binary matrix file, 0 for CSV */
+    int cols;
+    long rows_read;         /* rows returned since the file was (re)opened */
+    char *buffer;           /* CSV: text read from the file; buffer[start..end) is unparsed */
+    size_t start;
+    size_t end;
+    int at_eof;             /* CSV: the rest of the file is in the buffer */
+    long line;              /* CSV: lines consumed so far */
+    size_t rows;            /* binary: stored rows */
+    size_t stride;          /* binary: stored row length in doubles */
+    unsigned char *row;     /* binary: one stored row */
+    unsigned long checksum[2];  /* binary: running checksum of the rows read and the stored one */
+    unsigned long expected[2];
+} MatrixReader;
+
+/* Opens a CSV or binary matrix file for reading row by row, telling them apart by the magic.
+ * On failure returns NULL with *error_line set as by read_csv_file. */
+MatrixReader* open_matrix_reader(const char *file_name, long *error_line);
+
+/* Reads the next rows of the file, at most max_rows of them, into rows 0.. of block, which
+ * must have reader->cols columns. Returns the number of rows read, 0 at the end of the file, or
+ * -1 on a malformed row (its line number is stored in *error_line), a read error or, at the end
+ * of a binary file, a checksum mismatch (with *error_line set to 0). */
+int read_matrix_rows(MatrixReader *reader, Matrix *block, int max_rows, long *error_line);
+
+/* Moves the reader back to the first row; returns 1 on success */
+int rewind_matrix_reader(MatrixReader *reader);
+
+/* Closes the file of a reader and frees it */
+void close_matrix_reader(MatrixReader *reader);
+
+#endif
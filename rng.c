@@ -0,0 +1,57 @@
+#include "rng.h"
+
+#define RNG_MASK 0xFFFFFFFFUL
+#define RNG_GOLDEN 0x9E3779B9UL
+
+/* Helper function to rotate a 32-bit value left */
+static unsigned long rotate_left(unsigned long x, int bits) {
+    return ((x << bits) | (x >> (32 - bits))) & RNG_MASK;
+}
+
+/* Helper function to scramble a 32-bit value (the MurmurHash3 finalizer, a bijection) */
+static unsigned long mix32(unsigned long h) {
+    h &= RNG_MASK;
+    h ^= h >> 16;
+    h = (h * 0x85EBCA6BUL) & RNG_MASK;
+    h ^= h >> 13;
+    h = (h * 0xC2B2AE35UL) & RNG_MASK;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Function to seed a generator from both halves of the seed */
+void seed_random(RandomState *state, unsigned long seed) {
+    unsigned long low, high;
+    int i;
+    low = seed & RNG_MASK;
+    high = (seed >> 16 >> 16) & RNG_MASK;
+    for (i = 0; i < 4; i++) {
+        state->s[i] = mix32(low + (unsigned long)(i + 1) * RNG_GOLDEN) ^ mix32(high ^ (unsigned long)i);
+    }
+    if ((state->s[0] | state->s[1] | state->s[2] | state->s[3]) == 0) {
+        state->s[0] = RNG_GOLDEN;
+    }
+}
+
+/* Function to advance a generator by one step */
+unsigned long random_next(RandomState *state) {
+    unsigned long *s, result, t;
+    s = state->s;
+    result = (rotate_left((s[1] * 5) & RNG_MASK, 7) * 9) & RNG_MASK;
+    t = (s[1] << 9) & RNG_MASK;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 11);
+    return result;
+}
+
+/* Function to draw a uniform double from 27 + 26 random bits */
+double random_uniform(RandomState *state) {
+    unsigned long a, b;
+    a = random_next(state) >> 5;
+    b = random_next(state) >> 6;
+    return ((double)a * 67108864.0 + (double)b) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,20 @@
+#ifndef RNG_H
+#define RNG_H
+
+/* State of a xoshiro128** generator. Every draw only touches its own state, so each caller
+ * (or thread) keeps one and results depend on the seed alone. The 32-bit words are kept in
+ * unsigned long, masked to 32 bits, since ANSI C has no fixed-width 64-bit type. */
+typedef struct RandomState {
+    unsigned long s[4];
+} RandomState;
+
+/* Seeds a generator; equal seeds give equal sequences on every platform */
+void seed_random(RandomState *state, unsigned long seed);
+
+/* Draws the next 32-bit value */
+unsigned long random_next(RandomState *state);
+
+/* Draws a uniform double in [0, 1) with 53 random bits */
+double random_uniform(RandomState *state);
+
+#endif
@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <math.h>
+#include "selection.h"
+#include "silhouette.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* State shared by the runs of one sweep; everything but selection is read-only */
+typedef struct SelectionSweep {
+    Matrix *X;
+    Matrix *W;
+    double w_mean;
+    double w_norm_squared;
+    const int *ks;
+    const SelectionOptions *options;
+    ModelSelection *selection;
+} SelectionSweep;
+
+/* Function to fill in the default sweep options */
+void default_selection_options(SelectionOptions *options) {
+    default_symnmf_options(&options->symnmf);
+    options->restarts = 1;
+    options->seed = 0;
+    options->silhouette_sample = 0;
+}
+
+/* Helper function to record the number of updates and the time spent so far in a run */
+static int record_update(int iteration, double residual, double relative_change, double elapsed, void *data) {
+    SelectionRun *run = (SelectionRun *)data;
+    (void)residual;
+    (void)relative_change;
+    run->iterations = iteration;
+    run->seconds = elapsed;
+    return 0;
+}
+
+/* Helper function to compute ||W - H H^T||_F^2 = ||W||_F^2 - 2 tr(H^T W H) + ||H^T H||_F^2 into
+ * objective. The expanded form can round below 0 near a perfect fit, so it is clamped at 0.
+ * Returns 1 on success and 0 on failure. */
+static int symnmf_objective(Matrix *W, double w_norm_squared, Matrix *H, double *objective) {
+    int i, j;
+    double value, *h_row, *wh_row, *hth_row;
+    Matrix *WH = multiply_symmetric(W, H);
+    Matrix *HtH = gram_matrix(H);
+    if (WH == NULL || HtH == NULL) {
+        free_matrix(WH);
+        free_matrix(HtH);
+        return 0;
+    }
+    value = w_norm_squared;
+    for (i = 0; i < H->rows; i++) {
+        h_row = MATRIX_ROW(H, i);
+        wh_row = MATRIX_ROW(WH, i);
+        for (j = 0; j < H->cols; j++) {
+            value -= 2 * h_row[j] * wh_row[j];
+        }
+    }
+    for (i = 0; i < H->cols; i++) {
+        hth_row = MATRIX_ROW(HtH, i);
+        for (j = 0; j < H->cols; j++) {
+            value += hth_row[j] * hth_row[j];
+        }
+    }
+    free_matrix(WH);
+    free_matrix(HtH);
+    *objective = value > 0 ? value : 0.0;
+    return 1;
+}
+
+/* Helper function to score the final H of a run */
+static int score_run(SelectionSweep *sweep, SelectionRun *run, Matrix *H) {
+    int *labels;
+    SilhouetteScore score;
+    if (!symnmf_objective(sweep->W, sweep->w_norm_squared, H, &run->objective)) {
+        return 0;
+    }
+    labels = (int *)malloc((size_t)H->rows * sizeof(int));
+    if (labels == NULL) {
+        return 0;
+    }
+    hard_cluster_labels(H, labels);
+    if (silhouette_score(sweep->X, NULL, labels, run->k, sweep->options->silhouette_sample, run->seed, &score)) {
+        run->silhouette = score.score;
+        run->half_width = score.half_width;
+    } else {
+        run->silhouette = -1.0;
+        run->half_width = 0.0;
+    }
+    free(labels);
+    return 1;
+}
+
+/* Helper function to solve and score run index of the sweep, and keep its H if it is the best
+ * of its k so far. Ties go to the lower restart, so the choice does not depend on the order
+ * in which concurrent runs finish. */
+static int solve_run(SelectionSweep *sweep, int index) {
+    int restarts = sweep->options->restarts, slot = index / restarts;
+    Matrix *U, *H0, *H;
+    SymnmfOptions symnmf_options = sweep->options->symnmf;
+    ModelSelection *selection = sweep->selection;
+    SelectionRun *run = &selection->runs[index], *best;
+    run->k = sweep->ks[slot];
+    run->restart = index % restarts;
+    run->seed = sweep->options->seed + (unsigned long)run->restart;
+    symnmf_options.callback = record_update;
+    symnmf_options.callback_data = run;
+    U = random_uniform_matrix(sweep->X->rows, run->k, run->seed);
+    H0 = U == NULL ? NULL : scaled_matrix(U, 2 * sqrt(sweep->w_mean / run->k));
+    H = H0 == NULL ? NULL : run_symnmf_solver(create_symnmf_solver(H0, sweep->W), &symnmf_options);
+    free_matrix(U);
+    free_matrix(H0);
+    if (H == NULL || !score_run(sweep, run, H)) {
+        free_matrix(H);
+        return 0;
+    }
+    #pragma omp critical(model_selection_best)
+    {
+        best = selection->best[slot] == NULL ? NULL : &selection->runs[slot * restarts + selection->best_restart[slot]];
+        if (best == NULL || run->objective < best->objective
+            || (run->objective == best->objective && run->restart < best->restart)) {
+            free_matrix(selection->best[slot]);
+            selection->best[slot] = H;
+            selection->best_restart[slot] = run->restart;
+            H = NULL;
+        }
+    }
+    free_matrix(H);
+    return 1;
+}
+
+/* Helper function to order the runs by decreasing k, so the longest runs are handed out first */
+static void order_runs(const int *ks, int restarts, int count, int *order) {
+    int i, j, index;
+    for (i = 0; i < count; i++) {
+        index = i;
+        for (j = i; j > 0 && ks[order[j - 1] / restarts] < ks[index / restarts]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = index;
+    }
+}
+
+/* Function to sweep SYM-NMF over a grid of k values and restarts on one shared W */
+ModelSelection* select_symnmf_model(Matrix *X, const int *ks, int k_count, const SelectionOptions *options) {
+    int i, j, count, threads, concurrent, failed = 0;
+    int *order;
+    double *row;
+    SelectionSweep sweep;
+    ModelSelection *selection;
+    if (X == NULL || ks == NULL || k_count < 1 || options->restarts < 1) {
+        return NULL;
+    }
+    for (i = 0; i < k_count; i++) {
+        if (ks[i] < 1 || ks[i] >= X->rows) {
+            return NULL;
+        }
+    }
+    count = k_count * options->restarts;
+    selection = (ModelSelection *)calloc(1, sizeof(ModelSelection));
+    order = (int *)malloc((size_t)count * sizeof(int));
+    if (selection == NULL || order == NULL) {
+        free(selection);
+        free(order);
+        return NULL;
+    }
+    selection->k_count = k_count;
+    selection->restarts = options->restarts;
+    selection->runs = (SelectionRun *)calloc((size_t)count, sizeof(SelectionRun));
+    selection->best = (Matrix **)calloc((size_t)k_count, sizeof(Matrix *));
+    selection->best_restart = (int *)calloc((size_t)k_count, sizeof(int));
+    sweep.X = X;
+    sweep.W = norm(X);
+    sweep.ks = ks;
+    sweep.options = options;
+    sweep.selection = selection;
+    if (selection->runs == NULL || selection->best == NULL || selection->best_restart == NULL || sweep.W == NULL) {
+        free(order);
+        free_matrix(sweep.W);
+        free_model_selection(selection);
+        return NULL;
+    }
+    sweep.w_mean = matrix_mean(sweep.W);
+    sweep.w_norm_squared = 0.0;
+    for (i = 0; i < sweep.W->rows; i++) {
+        row = MATRIX_ROW(sweep.W, i);
+        for (j = 0; j < sweep.W->cols; j++) {
+            sweep.w_norm_squared += row[j] * row[j];
+        }
+    }
+    order_runs(ks, options->restarts, count, order);
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+    concurrent = threads > 1 && count >= threads;
+    #pragma omp parallel for schedule(dynamic) if(concurrent)
+    for (i = 0; i < count; i++) {
+        if (concurrent) {
+            set_num_threads(1);
+        }
+        if (!solve_run(&sweep, order[i])) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+    }
+    free(order);
+    free_matrix(sweep.W);
+    if (failed) {
+        free_model_selection(selection);
+        return NULL;
+    }
+    return selection;
+}
+
+/* Function to copy the runs of a sweep into a table */
+Matrix* model_selection_table(ModelSelection *selection) {
+    int i, count = selection->k_count * selection->restarts;
+    double *row;
+    Matrix *table = initialize_matrix_with_zeros(count, SELECTION_TABLE_COLUMNS);
+    if (table == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        row = MATRIX_ROW(table, i);
+        row[0] = selection->runs[i].k;
+        row[1] = selection->runs[i].restart;
+        row[2] = (double)selection->runs[i].seed;
+        row[3] = selection->runs[i].iterations;
+        row[4] = selection->runs[i].objective;
+        row[5] = selection->runs[i].silhouette;
+    }
+    return table;
+}
+
+/* Function to free a model selection */
+void free_model_selection(ModelSelection *selection) {
+    int i;
+    if (selection == NULL) {
+        return;
+    }
+    if (selection->best != NULL) {
+        for (i = 0; i < selection->k_count; i++) {
+            free_matrix(selection->best[i]);
+        }
+    }
+    free(selection->runs);
+    free(selection->best);
+    free(selection->best_restart);
+    free(selection);
+}
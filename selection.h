@@ -0,0 +1,57 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "symnmf.h"
+
+/* Columns of the table returned by model_selection_table */
+#define SELECTION_TABLE_COLUMNS 6
+
+/* One SYM-NMF run of a model selection sweep */
+typedef struct SelectionRun {
+    int k;
+    int restart;            /* from 0 */
+    unsigned long seed;     /* seed of the initial H: the sweep seed + restart */
+    int iterations;         /* updates made */
+    double seconds;         /* time spent iterating */
+    double objective;       /* ||W - H H^T||_F^2 at the final H */
+    double silhouette;      /* silhouette score of the hard clustering of the final H, -1 when
+                             * it has fewer than two clusters */
+    double half_width;      /* 95% half-width of a sampled silhouette score, 0 otherwise */
+} SelectionRun;
+
+/* Results of a sweep over a grid of k values, with restarts runs per k */
+typedef struct ModelSelection {
+    int k_count;
+    int restarts;
+    SelectionRun *runs;     /* k_count * restarts runs: the restarts of the first k, then of the next */
+    Matrix **best;          /* per k: the final H of the restart with the lowest objective */
+    int *best_restart;      /* per k: that restart, the first one on ties */
+} ModelSelection;
+
+/* Options of a model selection sweep */
+typedef struct SelectionOptions {
+    SymnmfOptions symnmf;   /* update and stopping rule of every run; the callback is not called */
+    int restarts;           /* runs per k, at least 1 */
+    unsigned long seed;     /* restart r starts from the H drawn with seed + r */
+    int silhouette_sample;  /* points sampled by silhouette_score, 0 to score every point */
+} SelectionOptions;
+
+/* Fills in one restart with seed 0, the default stopping rule and unsampled silhouette scores */
+void default_selection_options(SelectionOptions *options);
+
+/* Runs SYM-NMF on the points X for every k of the grid (1 <= k < n) and every restart. W = norm(X)
+ * is computed once and shared read-only by all the runs. Restart r of a given k starts like
+ * fit_symnmf from random_uniform_matrix(n, k, seed + r), so it gives exactly that H. When there
+ * are at least as many runs as threads the runs are solved concurrently, one thread each;
+ * otherwise they are solved one after the other on all the threads. Every run is scored by its
+ * objective and the silhouette score of its clustering. Returns NULL on failure. */
+ModelSelection* select_symnmf_model(Matrix *X, const int *ks, int k_count, const SelectionOptions *options);
+
+/* Copies the runs into a table with one row per run: k, restart, seed, iterations, objective and
+ * silhouette score */
+Matrix* model_selection_table(ModelSelection *selection);
+
+/* Frees a model selection and the H matrices it holds */
+void free_model_selection(ModelSelection *selection);
+
+#endif
@@ -1,10 +1,10 @@
 from setuptools import setup, Extension
 
 module = Extension('mysymnmf',
-                    sources=['symnmfmodule.c', 'symnmf.c'],
+                    sources=['symnmfmodule.c', 'symnmf.c', 'gemm.c', 'vecmath.c', 'sparse.c', 'streaming.c', 'matrixio.c', 'rng.c', 'kmeans.c', 'silhouette.c', 'selection.c'],
                     include_dirs=[],
-                    extra_compile_args=[],
-                    extra_link_args=[])
+                    extra_compile_args=['-fopenmp'],
+                    extra_link_args=['-fopenmp'])
 
 setup(name='mysymnmf',
       version='1.0',
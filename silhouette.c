@@ -0,0 +1,368 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "silhouette.h"
+#include "gemm.h"
+#include "rng.h"
+#include "vecmath.h"
+
+/* Helper function to count the points of every cluster; returns 0 if a label is out of range */
+static int count_clusters(const int *labels, int n, int k, long *sizes) {
+    int i;
+    memset(sizes, 0, (size_t)k * sizeof(long));
+    for (i = 0; i < n; i++) {
+        if (labels[i] < 0 || labels[i] >= k) {
+            return 0;
+        }
+        sizes[labels[i]]++;
+    }
+    return 1;
+}
+
+/* The points in cluster order: cluster c occupies positions starts[c] .. starts[c + 1] - 1 */
+typedef struct ClusterLayout {
+    int k;
+    const int *labels;
+    long *sizes;        /* points in every cluster */
+    long *starts;       /* first position of every cluster, k + 1 entries */
+    int *order;         /* point at every position */
+    int *positions;     /* position of every point */
+    Matrix *sorted;     /* the points in cluster order */
+    SimilarityPoints *prepared; /* the sorted points prepared for similarity_distances */
+} ClusterLayout;
+
+/* Helper function to free a cluster layout */
+static void free_cluster_layout(ClusterLayout *layout) {
+    free(layout->sizes);
+    free(layout->starts);
+    free(layout->order);
+    free(layout->positions);
+    free_similarity_points(layout->prepared);
+    free_matrix(layout->sorted);
+}
+
+/* Helper function to copy the points in cluster order, keeping their order within a cluster */
+static int build_cluster_layout(Matrix *points, const int *labels, int k, ClusterLayout *layout) {
+    int n = points->rows, i, c;
+    long position;
+    memset(layout, 0, sizeof(ClusterLayout));
+    layout->k = k;
+    layout->labels = labels;
+    layout->sizes = (long *)calloc((size_t)k, sizeof(long));
+    layout->starts = (long *)calloc((size_t)k + 1, sizeof(long));
+    layout->order = (int *)malloc((size_t)n * sizeof(int));
+    layout->positions = (int *)malloc((size_t)n * sizeof(int));
+    layout->sorted = initialize_matrix_with_zeros(n, points->cols);
+    if (layout->sizes == NULL || layout->starts == NULL || layout->order == NULL || layout->positions == NULL
+        || layout->sorted == NULL || !count_clusters(labels, n, k, layout->sizes)) {
+        free_cluster_layout(layout);
+        return 0;
+    }
+    for (c = 0; c < k; c++) {
+        layout->starts[c + 1] = layout->starts[c] + layout->sizes[c];
+    }
+    for (i = 0; i < n; i++) {
+        position = layout->starts[labels[i]]++;
+        layout->order[position] = i;
+        layout->positions[i] = (int)position;
+        memcpy(MATRIX_ROW(layout->sorted, position), MATRIX_ROW(points, i), (size_t)points->cols * sizeof(double));
+    }
+    for (c = 0; c < k; c++) {
+        layout->starts[c] -= layout->sizes[c];
+    }
+    layout->prepared = prepare_similarity_points(layout->sorted);
+    if (layout->prepared == NULL) {
+        free_cluster_layout(layout);
+        return 0;
+    }
+    return 1;
+}
+
+/* Helper function to compute the squared distances from point i to the count points at
+ * positions j0 onwards. Entries of the similarity matrix give them as -2 ln A_ij; a block with
+ * an entry that underflowed to 0 (the diagonal aside) is recomputed from the points instead. */
+static int block_distances(ClusterLayout *layout, Matrix *similarity, int i, int j0, int count,
+                           double *out, double *workspace) {
+    int j, other, underflowed = 0;
+    double value, *row;
+    if (similarity != NULL) {
+        row = MATRIX_ROW(similarity, i);
+        for (j = 0; j < count; j++) {
+            other = layout->order[j0 + j];
+            value = row[other];
+            if (value > 0) {
+                out[j] = value < 1.0 ? -2.0 * log(value) : 0.0;
+            } else {
+                out[j] = 0.0;
+                underflowed |= other != i;
+            }
+        }
+        if (!underflowed) {
+            return 1;
+        }
+    }
+    return similarity_distances(layout->prepared, layout->positions[i], j0, count, out, workspace);
+}
+
+/* Helper function to compute the silhouette of a point from its distance sums to every cluster */
+static double point_silhouette(const double *sums, int own, const long *sizes, int k) {
+    int c;
+    double a, b = -1.0, mean, largest;
+    if (sizes[own] <= 1) {
+        return 0.0;
+    }
+    a = sums[own] / (double)(sizes[own] - 1);
+    for (c = 0; c < k; c++) {
+        if (c != own && sizes[c] > 0) {
+            mean = sums[c] / (double)sizes[c];
+            if (b < 0 || mean < b) {
+                b = mean;
+            }
+        }
+    }
+    largest = a > b ? a : b;
+    return largest > 0 ? (b - a) / largest : 0.0;
+}
+
+/* Helper function to compute the squared distances from a tile of points to the block of points
+ * at positions j0 onwards, one row of SILHOUETTE_BLOCK per point. Wide points take the dot
+ * products of the whole tile from one gemm, so the block is packed once per tile. */
+static int tile_distances(ClusterLayout *layout, Matrix *similarity, const int *rows, int count, int j0,
+                          int block, Matrix *queries, double *distances, double *workspace) {
+    int q, j;
+    double value, *row, *norms = layout->prepared->squared_norms->data;
+    Matrix *coordinates = layout->prepared->coordinates;
+    if (similarity != NULL || queries == NULL) {
+        for (q = 0; q < count; q++) {
+            if (!block_distances(layout, similarity, rows[q], j0, block, distances + (size_t)q * SILHOUETTE_BLOCK,
+                                 workspace)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    if (!gemm(count, block, queries->cols, queries->data, (size_t)queries->stride, 0, coordinates->data + j0,
+              (size_t)coordinates->stride, distances, SILHOUETTE_BLOCK, 0, workspace)) {
+        return 0;
+    }
+    for (q = 0; q < count; q++) {
+        row = distances + (size_t)q * SILHOUETTE_BLOCK;
+        for (j = 0; j < block; j++) {
+            value = norms[layout->positions[rows[q]]] + norms[j0 + j] - 2.0 * row[j];
+            row[j] = value > 0 ? value : 0;
+        }
+    }
+    return 1;
+}
+
+/* Helper function to score one tile of points. Every row of distances is split at the cluster
+ * boundaries and each piece is added to the sum of its cluster, in a fixed order, so the scores
+ * do not depend on the number of threads. queries is scratch for the points of the tile when
+ * they are wide enough for gemm, NULL otherwise. */
+static int score_tile(ClusterLayout *layout, Matrix *similarity, const int *rows, int count, double *scores,
+                      Matrix *queries, double *sums, double *distances, double *workspace) {
+    int n = layout->sorted->rows, k = layout->k, j0, block, q, c, position, first = 0;
+    long start, end;
+    double *point_sums, *row;
+    if (queries != NULL) {
+        for (q = 0; q < count; q++) {
+            memcpy(MATRIX_ROW(queries, q), MATRIX_ROW(layout->sorted, layout->positions[rows[q]]),
+                   (size_t)queries->cols * sizeof(double));
+        }
+    }
+    memset(sums, 0, (size_t)count * k * sizeof(double));
+    for (j0 = 0; j0 < n; j0 += SILHOUETTE_BLOCK) {
+        block = n - j0 < SILHOUETTE_BLOCK ? n - j0 : SILHOUETTE_BLOCK;
+        while (layout->starts[first + 1] <= j0) {
+            first++;
+        }
+        if (!tile_distances(layout, similarity, rows, count, j0, block, queries, distances, workspace)) {
+            return 0;
+        }
+        for (q = 0; q < count; q++) {
+            row = distances + (size_t)q * SILHOUETTE_BLOCK;
+            position = layout->positions[rows[q]];
+            if (position >= j0 && position < j0 + block) {
+                row[position - j0] = 0.0;
+            }
+            point_sums = sums + (size_t)q * k;
+            for (c = first; c < k && layout->starts[c] < j0 + block; c++) {
+                start = layout->starts[c] > j0 ? layout->starts[c] : j0;
+                end = layout->starts[c + 1] < j0 + block ? layout->starts[c + 1] : j0 + block;
+                if (end > start) {
+                    point_sums[c] += sum_of_square_roots(row + (start - j0), (int)(end - start));
+                }
+            }
+        }
+    }
+    for (q = 0; q < count; q++) {
+        scores[q] = point_silhouette(sums + (size_t)q * k, layout->labels[rows[q]], layout->sizes, k);
+    }
+    return 1;
+}
+
+/* Helper function to score the given points of a layout.
+ * Tiles of SILHOUETTE_TILE points are handed out dynamically to the threads; each thread keeps
+ * the distances of its tile to one block of points and the k distance sums of every point. */
+static int score_points(ClusterLayout *layout, Matrix *similarity, const int *rows, int count, double *scores) {
+    int d, tiles, tile, tile_count, wide, failed = 0;
+    double *sums, *distances, *workspace;
+    Matrix *queries;
+    d = layout->sorted->cols;
+    wide = similarity == NULL && d >= SYM_GEMM_MIN_DIM;
+    tiles = (count + SILHOUETTE_TILE - 1) / SILHOUETTE_TILE;
+    #pragma omp parallel private(tile, tile_count, sums, distances, workspace, queries)
+    {
+        sums = allocate_matrix_data(SILHOUETTE_TILE, layout->k);
+        distances = allocate_matrix_data(SILHOUETTE_TILE, SILHOUETTE_BLOCK);
+        workspace = allocate_matrix_data(1, (int)gemm_workspace_size(SILHOUETTE_TILE, SILHOUETTE_BLOCK, d));
+        queries = wide ? initialize_matrix_with_zeros(SILHOUETTE_TILE, d) : NULL;
+        #pragma omp for schedule(dynamic)
+        for (tile = 0; tile < tiles; tile++) {
+            tile_count = count - tile * SILHOUETTE_TILE;
+            tile_count = tile_count < SILHOUETTE_TILE ? tile_count : SILHOUETTE_TILE;
+            if (sums == NULL || distances == NULL || workspace == NULL || (wide && queries == NULL)
+                || !score_tile(layout, similarity, rows + tile * SILHOUETTE_TILE, tile_count,
+                               scores + tile * SILHOUETTE_TILE, queries, sums, distances, workspace)) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        free(sums);
+        free(distances);
+        free(workspace);
+        free_matrix(queries);
+    }
+    return !failed;
+}
+
+/* Function to compute the silhouette of the given points */
+int silhouette_samples(Matrix *points, Matrix *similarity, const int *labels, int k,
+                       const int *rows, int count, double *scores) {
+    int ok;
+    ClusterLayout layout;
+    if (points == NULL || labels == NULL || k < 1
+        || (similarity != NULL && (similarity->rows != points->rows || similarity->cols != points->rows))
+        || !build_cluster_layout(points, labels, k, &layout)) {
+        return 0;
+    }
+    ok = score_points(&layout, similarity, rows, count, scores);
+    free_cluster_layout(&layout);
+    return ok;
+}
+
+/* Helper function to draw the stratified sample. rows receives the sampled points cluster by
+ * cluster and taken the number drawn from every cluster; returns the sample size. */
+static int draw_stratified_sample(ClusterLayout *layout, int sample_size, unsigned long seed, int *rows,
+                                  long *taken) {
+    int n = layout->sorted->rows, c, swap, total = 0;
+    long t, share, pick, start, size;
+    int *pool;
+    RandomState state;
+    pool = (int *)malloc((size_t)n * sizeof(int));
+    if (pool == NULL) {
+        return 0;
+    }
+    memcpy(pool, layout->order, (size_t)n * sizeof(int));
+    seed_random(&state, seed);
+    for (c = 0; c < layout->k; c++) {
+        start = layout->starts[c];
+        size = layout->sizes[c];
+        share = (long)floor((double)sample_size * (double)size / (double)n + 0.5);
+        share = share < 2 ? 2 : share;
+        share = share > size ? size : share;
+        for (t = 0; t < share; t++) {
+            pick = start + t + (long)(random_uniform(&state) * (double)(size - t));
+            swap = pool[start + t];
+            pool[start + t] = pool[pick];
+            pool[pick] = swap;
+            rows[total++] = pool[start + t];
+        }
+        taken[c] = share;
+    }
+    free(pool);
+    return total;
+}
+
+/* Helper function to combine the scores of the strata into the estimate and its confidence bound.
+ * Each cluster mean is weighted by the cluster's share of the points; its variance carries the
+ * finite population correction, so a cluster scored in full adds no uncertainty. */
+static void estimate_from_strata(const double *scores, int n, int k, const long *sizes, const long *taken,
+                                 SilhouetteScore *result) {
+    int c;
+    long t, offset = 0;
+    double weight, mean, spread, variance = 0.0;
+    result->score = 0.0;
+    for (c = 0; c < k; c++) {
+        if (taken[c] == 0) {
+            continue;
+        }
+        mean = 0.0;
+        for (t = 0; t < taken[c]; t++) {
+            mean += scores[offset + t];
+        }
+        mean /= (double)taken[c];
+        spread = 0.0;
+        for (t = 0; t < taken[c]; t++) {
+            spread += (scores[offset + t] - mean) * (scores[offset + t] - mean);
+        }
+        spread = taken[c] > 1 ? spread / (double)(taken[c] - 1) : 0.0;
+        weight = (double)sizes[c] / (double)n;
+        result->score += weight * mean;
+        variance += weight * weight * (1.0 - (double)taken[c] / (double)sizes[c]) * spread / (double)taken[c];
+        offset += taken[c];
+    }
+    result->half_width = SILHOUETTE_Z * sqrt(variance);
+}
+
+/* Function to compute or estimate the silhouette score of a clustering */
+int silhouette_score(Matrix *points, Matrix *similarity, const int *labels, int k, int sample_size,
+                     unsigned long seed, SilhouetteScore *result) {
+    int n, c, i, clusters = 0, count = 0, ok = 0;
+    int *rows;
+    long *taken;
+    double *scores, sum;
+    ClusterLayout layout;
+    if (points == NULL || labels == NULL || k < 1) {
+        return 0;
+    }
+    n = points->rows;
+    if (similarity != NULL && (similarity->rows != n || similarity->cols != n)) {
+        return 0;
+    }
+    if (!build_cluster_layout(points, labels, k, &layout)) {
+        return 0;
+    }
+    taken = (long *)calloc((size_t)k, sizeof(long));
+    rows = (int *)malloc((size_t)n * sizeof(int));
+    scores = allocate_matrix_data(1, n);
+    for (c = 0; c < k; c++) {
+        clusters += layout.sizes[c] > 0;
+    }
+    if (taken != NULL && rows != NULL && scores != NULL && clusters >= 2 && clusters <= n - 1) {
+        if (sample_size <= 0 || sample_size >= n) {
+            for (i = 0; i < n; i++) {
+                rows[i] = i;
+            }
+            count = n;
+        } else {
+            count = draw_stratified_sample(&layout, sample_size, seed, rows, taken);
+        }
+        ok = count > 0 && score_points(&layout, similarity, rows, count, scores);
+    }
+    if (ok && count == n) {
+        for (i = 0, sum = 0.0; i < n; i++) {
+            sum += scores[i];
+        }
+        result->score = sum / (double)n;
+        result->half_width = 0.0;
+    } else if (ok) {
+        estimate_from_strata(scores, n, k, layout.sizes, taken, result);
+    }
+    result->samples = count;
+    free(taken);
+    free(rows);
+    free(scores);
+    free_cluster_layout(&layout);
+    return ok;
+}
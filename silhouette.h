@@ -0,0 +1,43 @@
+#ifndef SILHOUETTE_H
+#define SILHOUETTE_H
+
+#include "symnmf.h"
+
+/* Points scored together by one thread. Their distances to a block of SILHOUETTE_BLOCK points
+ * are computed one after the other, so the coordinates of that block are read from cache.
+ * The points are copied in cluster order first, so the distances to a cluster are contiguous
+ * and are summed with vector instructions. */
+#define SILHOUETTE_TILE 32
+#define SILHOUETTE_BLOCK 1024
+
+/* Two-sided 95% quantile of the standard normal, for the confidence bound of a sampled score */
+#define SILHOUETTE_Z 1.959963984540054
+
+/* Silhouette score of a clustering and, when it was estimated from a sample, its 95% confidence
+ * interval score +- half_width. half_width is 0 when every point was scored. */
+typedef struct SilhouetteScore {
+    double score;
+    double half_width;
+    int samples;        /* points scored */
+} SilhouetteScore;
+
+/* Computes the silhouette s(i) = (b(i) - a(i)) / max(a(i), b(i)) of the count points rows[i] into
+ * scores: a(i) is the mean Euclidean distance from point i to the other points of its cluster, b(i)
+ * the smallest mean distance to the points of another non-empty cluster, and s(i) = 0 for a point
+ * alone in its cluster. labels holds the cluster, in [0, k), of every point. When similarity is not
+ * NULL it must be the matrix sym computed for these points; the distances are then recovered as
+ * sqrt(-2 ln A_ij) and only recomputed from the points where A_ij underflowed to 0.
+ * Returns 1 on success and 0 on failure. */
+int silhouette_samples(Matrix *points, Matrix *similarity, const int *labels, int k,
+                       const int *rows, int count, double *scores);
+
+/* Computes the mean silhouette of all n points, like sklearn's silhouette_score, or with
+ * 0 < sample_size < n estimates it from a sample stratified by cluster: every cluster contributes
+ * a share of sample_size proportional to its size (at least two points, or all of them), drawn
+ * without replacement with a generator seeded by seed, and its mean is weighted by its size.
+ * The clustering needs between 2 and n - 1 non-empty clusters. similarity is as in
+ * silhouette_samples. Returns 1 on success and 0 on failure. */
+int silhouette_score(Matrix *points, Matrix *similarity, const int *labels, int k, int sample_size,
+                     unsigned long seed, SilhouetteScore *result);
+
+#endif
@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sparse.h"
+#include "gemm.h"
+#include "vecmath.h"
+
+/* Number of candidate points whose distances are computed at once */
+#define KNN_BLOCK 1024
+
+/* A candidate neighbor; candidates are ordered by distance, then by index */
+typedef struct Neighbor {
+    double distance;
+    int index;
+} Neighbor;
+
+/* Helper function to order two candidates by (distance, index) */
+static int neighbor_before(const Neighbor *a, const Neighbor *b) {
+    return a->distance < b->distance || (a->distance == b->distance && a->index < b->index);
+}
+
+/* Helper function to compare two entries of a row by column, for qsort */
+static int compare_neighbor_index(const void *a, const void *b) {
+    return ((const Neighbor *)a)->index - ((const Neighbor *)b)->index;
+}
+
+/* Helper function to offer a candidate to a bounded max-heap that keeps the capacity nearest */
+static void heap_offer(Neighbor *heap, int *size, int capacity, Neighbor candidate) {
+    int child, parent;
+    Neighbor swap;
+    if (*size < capacity) {
+        child = (*size)++;
+        heap[child] = candidate;
+        while (child > 0) {
+            parent = (child - 1) / 2;
+            if (!neighbor_before(&heap[parent], &heap[child])) {
+                break;
+            }
+            swap = heap[parent];
+            heap[parent] = heap[child];
+            heap[child] = swap;
+            child = parent;
+        }
+        return;
+    }
+    if (!neighbor_before(&candidate, &heap[0])) {
+        return;
+    }
+    heap[0] = candidate;
+    parent = 0;
+    while ((child = 2 * parent + 1) < *size) {
+        if (child + 1 < *size && neighbor_before(&heap[child], &heap[child + 1])) {
+            child++;
+        }
+        if (!neighbor_before(&heap[parent], &heap[child])) {
+            break;
+        }
+        swap = heap[parent];
+        heap[parent] = heap[child];
+        heap[child] = swap;
+        parent = child;
+    }
+}
+
+/* Helper function to find the directed neighbors of point i.
+ * With capacity > 0 the capacity nearest points within the radius are written to out;
+ * with capacity == 0 every point within the radius is written to out, or only counted
+ * when out is NULL. Returns the number of neighbors, or -1 if a distance kernel failed. */
+static int collect_neighbors(SimilarityPoints *points, int i, int capacity, double radius_squared,
+                             Neighbor *out, double *distances, double *workspace) {
+    int n, j0, count, j, found = 0;
+    Neighbor candidate;
+    n = points->points->rows;
+    for (j0 = 0; j0 < n; j0 += KNN_BLOCK) {
+        count = n - j0 < KNN_BLOCK ? n - j0 : KNN_BLOCK;
+        if (!similarity_distances(points, i, j0, count, distances, workspace)) {
+            return -1;
+        }
+        for (j = 0; j < count; j++) {
+            if (j0 + j == i || (radius_squared > 0 && distances[j] > radius_squared)) {
+                continue;
+            }
+            candidate.distance = distances[j];
+            candidate.index = j0 + j;
+            if (capacity > 0) {
+                heap_offer(out, &found, capacity, candidate);
+            } else {
+                if (out != NULL) {
+                    out[found] = candidate;
+                }
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+/* Function to allocate a sparse matrix */
+SparseMatrix* allocate_sparse_matrix(int rows, int cols, long nnz) {
+    SparseMatrix *matrix = (SparseMatrix *)calloc(1, sizeof(SparseMatrix));
+    if (matrix == NULL) {
+        return NULL;
+    }
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->row_offsets = (long *)calloc((size_t)rows + 1, sizeof(long));
+    matrix->col_indices = (int *)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    matrix->values = (double *)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(double));
+    if (matrix->row_offsets == NULL || matrix->col_indices == NULL || matrix->values == NULL) {
+        free_sparse_matrix(matrix);
+        return NULL;
+    }
+    return matrix;
+}
+
+/* Function to free a sparse matrix */
+void free_sparse_matrix(SparseMatrix *matrix) {
+    if (matrix == NULL) {
+        return;
+    }
+    free(matrix->row_offsets);
+    free(matrix->col_indices);
+    free(matrix->values);
+    free(matrix);
+}
+
+/* Function to expand a sparse matrix into a dense one */
+Matrix* sparse_to_matrix(SparseMatrix *matrix) {
+    int i;
+    long e;
+    double *row;
+    Matrix *dense;
+    if (matrix == NULL) {
+        return NULL;
+    }
+    dense = initialize_matrix_with_zeros(matrix->rows, matrix->cols);
+    if (dense == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < matrix->rows; i++) {
+        row = MATRIX_ROW(dense, i);
+        for (e = matrix->row_offsets[i]; e < matrix->row_offsets[i + 1]; e++) {
+            row[matrix->col_indices[e]] = matrix->values[e];
+        }
+    }
+    return dense;
+}
+
+/* Helper function to compute the directed neighbor lists of every point.
+ * On success *edges holds the neighbors of point i at (*edges)[offsets[i]] .. (*edges)[offsets[i + 1] - 1]. */
+static int directed_neighbors(SimilarityPoints *points, int neighbors, double radius_squared,
+                              long *offsets, Neighbor **edges) {
+    int n, i, found, failed = 0;
+    double *distances, *workspace;
+    n = points->points->rows;
+    *edges = NULL;
+    if (neighbors > 0) {
+        for (i = 0; i <= n; i++) {
+            offsets[i] = (long)i * neighbors;
+        }
+        *edges = (Neighbor *)malloc(((size_t)n * neighbors + 1) * sizeof(Neighbor));
+        if (*edges == NULL) {
+            return 0;
+        }
+    }
+    /* Without a neighbor limit the lists have unknown lengths: count them first, then fill */
+    #pragma omp parallel private(i, found, distances, workspace)
+    {
+        distances = allocate_matrix_data(1, KNN_BLOCK);
+        workspace = allocate_matrix_data(1, (int)gemm_workspace_size(1, KNN_BLOCK, points->points->cols));
+        if (distances == NULL) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        if (neighbors == 0) {
+            #pragma omp for schedule(dynamic, 16)
+            for (i = 0; i < n; i++) {
+                found = failed ? -1 : collect_neighbors(points, i, 0, radius_squared, NULL, distances, workspace);
+                if (found < 0) {
+                    #pragma omp atomic write
+                    failed = 1;
+                }
+                offsets[i + 1] = found;
+            }
+            #pragma omp single
+            {
+                offsets[0] = 0;
+                for (i = 0; i < n; i++) {
+                    offsets[i + 1] += offsets[i];
+                }
+                *edges = failed ? NULL : (Neighbor *)malloc(((size_t)offsets[n] + 1) * sizeof(Neighbor));
+                if (*edges == NULL) {
+                    failed = 1;
+                }
+            }
+        }
+        #pragma omp for schedule(dynamic, 16)
+        for (i = 0; i < n; i++) {
+            if (failed) {
+                continue;
+            }
+            found = collect_neighbors(points, i, neighbors, radius_squared, *edges + offsets[i], distances, workspace);
+            if (found < 0) {
+                #pragma omp atomic write
+                failed = 1;
+            } else if (neighbors > 0) {
+                /* Fewer points than requested passed the radius; mark the unused slots */
+                for (; found < neighbors; found++) {
+                    (*edges)[offsets[i] + found].index = -1;
+                }
+            }
+        }
+        free(distances);
+        free(workspace);
+    }
+    if (failed) {
+        free(*edges);
+        *edges = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+/* Function to compute the sparse, union-symmetrized similarity graph */
+SparseMatrix* knn_sym(Matrix *matrix, int neighbors, double radius) {
+    int n, i, j;
+    long e, kept, *offsets, *row_start, *fill;
+    Neighbor *edges, *both, *row;
+    SimilarityPoints *points;
+    SparseMatrix *result;
+    if (matrix == NULL || neighbors < 0 || radius < 0 || (neighbors == 0 && radius == 0)) {
+        return NULL;
+    }
+    n = matrix->rows;
+    if (neighbors > n - 1) {
+        neighbors = n - 1;
+    }
+    points = prepare_similarity_points(matrix);
+    offsets = (long *)calloc((size_t)n + 1, sizeof(long));
+    row_start = (long *)calloc((size_t)n + 1, sizeof(long));
+    fill = (long *)calloc((size_t)n + 1, sizeof(long));
+    edges = NULL;
+    if (points == NULL || offsets == NULL || row_start == NULL || fill == NULL
+        || !directed_neighbors(points, neighbors, radius * radius, offsets, &edges)) {
+        free_similarity_points(points);
+        free(offsets);
+        free(row_start);
+        free(fill);
+        return NULL;
+    }
+    free_similarity_points(points);
+    /* Every directed edge i -> j is stored in row i and in row j; duplicates are merged below */
+    for (i = 0; i < n; i++) {
+        for (e = offsets[i]; e < offsets[i + 1]; e++) {
+            if (edges[e].index >= 0) {
+                row_start[i + 1]++;
+                row_start[edges[e].index + 1]++;
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        row_start[i + 1] += row_start[i];
+    }
+    both = (Neighbor *)malloc(((size_t)row_start[n] + 1) * sizeof(Neighbor));
+    if (both == NULL) {
+        free(edges);
+        free(offsets);
+        free(row_start);
+        free(fill);
+        return NULL;
+    }
+    memcpy(fill, row_start, ((size_t)n + 1) * sizeof(long));
+    for (i = 0; i < n; i++) {
+        for (e = offsets[i]; e < offsets[i + 1]; e++) {
+            j = edges[e].index;
+            if (j >= 0) {
+                both[fill[i]] = edges[e];
+                fill[i]++;
+                both[fill[j]].distance = edges[e].distance;
+                both[fill[j]].index = i;
+                fill[j]++;
+            }
+        }
+    }
+    free(edges);
+    /* Sort every row by column and drop the second copy of mutual neighbors; the distance
+     * of a pair does not depend on which endpoint computed it, so either copy will do */
+    #pragma omp parallel for schedule(dynamic, 64) private(row, e, kept)
+    for (i = 0; i < n; i++) {
+        row = both + row_start[i];
+        qsort(row, (size_t)(row_start[i + 1] - row_start[i]), sizeof(Neighbor), compare_neighbor_index);
+        kept = 0;
+        for (e = 0; e < row_start[i + 1] - row_start[i]; e++) {
+            if (kept == 0 || row[e].index != row[kept - 1].index) {
+                row[kept++] = row[e];
+            }
+        }
+        offsets[i + 1] = kept;
+    }
+    offsets[0] = 0;
+    for (i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    result = allocate_sparse_matrix(n, n, offsets[n]);
+    if (result != NULL) {
+        memcpy(result->row_offsets, offsets, ((size_t)n + 1) * sizeof(long));
+        #pragma omp parallel for schedule(dynamic, 64) private(row, e)
+        for (i = 0; i < n; i++) {
+            row = both + row_start[i];
+            for (e = 0; e < offsets[i + 1] - offsets[i]; e++) {
+                result->col_indices[offsets[i] + e] = row[e].index;
+                result->values[offsets[i] + e] = row[e].distance;
+            }
+            scaled_exp(result->values + offsets[i], (int)(offsets[i + 1] - offsets[i]), -0.5);
+        }
+    }
+    free(both);
+    free(offsets);
+    free(row_start);
+    free(fill);
+    return result;
+}
+
+/* Function to compute the degrees of a sparse similarity matrix, summing each row in column order */
+Vector* sparse_degrees(SparseMatrix *sym_matrix) {
+    int i;
+    long e;
+    double degree;
+    Vector *degrees;
+    if (sym_matrix == NULL) {
+        return NULL;
+    }
+    degrees = initialize_vector_with_zeros(sym_matrix->rows);
+    if (degrees == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < sym_matrix->rows; i++) {
+        degree = 0.0;
+        for (e = sym_matrix->row_offsets[i]; e < sym_matrix->row_offsets[i + 1]; e++) {
+            degree += sym_matrix->values[e];
+        }
+        degrees->data[i] = degree;
+    }
+    return degrees;
+}
+
+/* Function to compute the diagonal degree matrix of the sparse similarity graph */
+Vector* knn_ddg(Matrix *matrix, int neighbors, double radius) {
+    Vector *degrees;
+    SparseMatrix *sym_matrix = knn_sym(matrix, neighbors, radius);
+    if (sym_matrix == NULL) {
+        return NULL;
+    }
+    degrees = sparse_degrees(sym_matrix);
+    free_sparse_matrix(sym_matrix);
+    return degrees;
+}
+
+/* Function to scale a sparse similarity matrix in place to D^-1/2 * A * D^-1/2 */
+void normalize_sparse_similarity(SparseMatrix *sym_matrix, Vector *inverse_sqrt) {
+    int i;
+    long e;
+    double scale_i, *scale;
+    scale = inverse_sqrt->data;
+    for (i = 0; i < sym_matrix->rows; i++) {
+        scale_i = scale[i];
+        for (e = sym_matrix->row_offsets[i]; e < sym_matrix->row_offsets[i + 1]; e++) {
+            sym_matrix->values[e] = (scale_i * sym_matrix->values[e]) * scale[sym_matrix->col_indices[e]];
+        }
+    }
+}
+
+/* Function to compute the normalized sparse similarity matrix */
+SparseMatrix* knn_norm(Matrix *matrix, int neighbors, double radius) {
+    Vector *degrees, *inverse_sqrt;
+    SparseMatrix *sym_matrix = knn_sym(matrix, neighbors, radius);
+    if (sym_matrix == NULL) {
+        return NULL;
+    }
+    degrees = sparse_degrees(sym_matrix);
+    inverse_sqrt = compute_inverse_sqrt(degrees);
+    free_vector(degrees);
+    if (inverse_sqrt == NULL) {
+        free_sparse_matrix(sym_matrix);
+        return NULL;
+    }
+    normalize_sparse_similarity(sym_matrix, inverse_sqrt);
+    free_vector(inverse_sqrt);
+    return sym_matrix;
+}
+
+/* Function to compute the mean of all entries of a sparse matrix, implicit zeros included */
+double sparse_mean(SparseMatrix *matrix) {
+    long e;
+    double sum = 0.0;
+    for (e = 0; e < matrix->row_offsets[matrix->rows]; e++) {
+        sum += matrix->values[e];
+    }
+    return sum / ((double)matrix->rows * (double)matrix->cols);
+}
+
+/* Function to multiply a sparse matrix by a dense one, one output row per thread at a time */
+void multiply_sparse(SparseMatrix *sparse, const double *dense, size_t ld, int cols, double *result, size_t result_ld) {
+    int i, c;
+    long e;
+    double value, *result_row;
+    const double *dense_row;
+    #pragma omp parallel for schedule(dynamic, 64) private(c, e, value, result_row, dense_row)
+    for (i = 0; i < sparse->rows; i++) {
+        result_row = result + (size_t)i * result_ld;
+        for (c = 0; c < cols; c++) {
+            result_row[c] = 0.0;
+        }
+        for (e = sparse->row_offsets[i]; e < sparse->row_offsets[i + 1]; e++) {
+            value = sparse->values[e];
+            dense_row = dense + (size_t)sparse->col_indices[e] * ld;
+            for (c = 0; c < cols; c++) {
+                result_row[c] += value * dense_row[c];
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "symnmf.h"
+
+/* Sparse matrix in compressed sparse row (CSR) format. The entries of row i are
+ * values[row_offsets[i]] .. values[row_offsets[i + 1] - 1], in columns col_indices[...]
+ * sorted in ascending order. */
+typedef struct SparseMatrix {
+    int rows;
+    int cols;
+    long *row_offsets;
+    int *col_indices;
+    double *values;
+} SparseMatrix;
+
+/* Allocates a sparse matrix with room for nnz entries */
+SparseMatrix* allocate_sparse_matrix(int rows, int cols, long nnz);
+
+/* Frees the memory allocated for a sparse matrix */
+void free_sparse_matrix(SparseMatrix *matrix);
+
+/* Expands a sparse matrix into a dense matrix (for output only) */
+Matrix* sparse_to_matrix(SparseMatrix *matrix);
+
+/* Computes the sparse similarity graph of the points: each point keeps its neighbors nearest
+ * points (neighbors > 0), or every point within distance radius (radius > 0), or the nearest
+ * neighbors within radius when both are given. The graph is symmetrized by union, so
+ * W_ij is stored whenever i is a neighbor of j or j is a neighbor of i. */
+SparseMatrix* knn_sym(Matrix *matrix, int neighbors, double radius);
+
+/* Computes the degrees (row sums) of a sparse similarity matrix */
+Vector* sparse_degrees(SparseMatrix *sym_matrix);
+
+/* Computes the diagonal of the degree matrix of the sparse similarity graph */
+Vector* knn_ddg(Matrix *matrix, int neighbors, double radius);
+
+/* Scales a sparse similarity matrix in place to D^-1/2 * A * D^-1/2 */
+void normalize_sparse_similarity(SparseMatrix *sym_matrix, Vector *inverse_sqrt);
+
+/* Computes the normalized sparse similarity matrix */
+SparseMatrix* knn_norm(Matrix *matrix, int neighbors, double radius);
+
+/* Computes the mean over all rows * cols entries of a sparse matrix, counting the implicit zeros */
+double sparse_mean(SparseMatrix *matrix);
+
+/* Computes C = A * B for a sparse A and a dense B with cols columns (SpMM) */
+void multiply_sparse(SparseMatrix *sparse, const double *dense, size_t ld, int cols, double *result, size_t result_ld);
+
+/* Creates a solver whose W * H products use the sparse W; H is copied, W is borrowed */
+SymnmfSolver* create_sparse_symnmf_solver(Matrix *H, SparseMatrix *W);
+
+/* Performs the SYM-NMF algorithm on a sparse normalized similarity matrix */
+Matrix* sparse_symnmf(Matrix *H, SparseMatrix *W);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include "streaming.h"
+#include "gemm.h"
+#include "vecmath.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Helper function to read a block back from the cache, or compute it and append it to the cache */
+static int load_block(StreamingSimilarity *similarity, int i0, int rows, int j0, int cols) {
+    size_t count = (size_t)rows * (size_t)cols;
+    if (similarity->cache != NULL && similarity->cache_ready) {
+        return fread(similarity->block, sizeof(double), count, similarity->cache) == count;
+    }
+    if (!streaming_block(similarity, i0, rows, j0, cols, similarity->block, (size_t)cols)) {
+        return 0;
+    }
+    if (similarity->cache != NULL && fwrite(similarity->block, sizeof(double), count, similarity->cache) != count) {
+        /* The disk is full or failing: keep going without the cache */
+        fclose(similarity->cache);
+        similarity->cache = NULL;
+    }
+    return 1;
+}
+
+/* Function to prepare a streamed similarity matrix */
+StreamingSimilarity* create_streaming_similarity(Matrix *matrix, int normalized, const char *cache_file_name) {
+    Vector *degrees;
+    StreamingSimilarity *similarity;
+    if (matrix == NULL) {
+        return NULL;
+    }
+    similarity = (StreamingSimilarity *)calloc(1, sizeof(StreamingSimilarity));
+    if (similarity == NULL) {
+        return NULL;
+    }
+    similarity->points = prepare_similarity_points(matrix);
+    similarity->block = allocate_matrix_data(SYMM_BLOCK, SYMM_BLOCK);
+#ifdef _OPENMP
+    similarity->threads = omp_get_max_threads();
+#else
+    similarity->threads = 1;
+#endif
+    if (matrix->cols >= SYM_GEMM_MIN_DIM) {
+        /* Sized for a full row, the widest block print_streaming_matrix asks for; slices start
+         * on 64-byte boundaries */
+        similarity->thread_workspace = (gemm_workspace_size(1, matrix->rows, matrix->cols) + 7) / 8 * 8;
+        similarity->workspace = allocate_matrix_data(similarity->threads, (int)similarity->thread_workspace);
+    }
+    if (similarity->points == NULL || similarity->block == NULL
+        || (matrix->cols >= SYM_GEMM_MIN_DIM && similarity->workspace == NULL)) {
+        free_streaming_similarity(similarity);
+        return NULL;
+    }
+    if (normalized) {
+        /* ddg sums every row in ascending column order, exactly like compute_degrees on sym */
+        degrees = ddg(matrix);
+        similarity->inverse_sqrt = compute_inverse_sqrt(degrees);
+        free_vector(degrees);
+        if (similarity->inverse_sqrt == NULL) {
+            free_streaming_similarity(similarity);
+            return NULL;
+        }
+    }
+    if (cache_file_name != NULL) {
+        similarity->cache = fopen(cache_file_name, "w+b");
+        if (similarity->cache == NULL) {
+            free_streaming_similarity(similarity);
+            return NULL;
+        }
+    }
+    return similarity;
+}
+
+/* Function to free a streamed similarity matrix */
+void free_streaming_similarity(StreamingSimilarity *similarity) {
+    if (similarity == NULL) {
+        return;
+    }
+    free_similarity_points(similarity->points);
+    free_vector(similarity->inverse_sqrt);
+    free(similarity->block);
+    free(similarity->workspace);
+    if (similarity->cache != NULL) {
+        fclose(similarity->cache);
+    }
+    free(similarity);
+}
+
+/* Function to compute one block of the streamed matrix, one row per thread at a time */
+int streaming_block(StreamingSimilarity *similarity, int i0, int rows, int j0, int cols, double *out, size_t ld) {
+    int i, j, failed = 0;
+    double scale_i, *row, *scale, *workspace;
+    #pragma omp parallel num_threads(similarity->threads) private(i, j, scale_i, row, scale, workspace)
+    {
+        workspace = similarity->workspace;
+#ifdef _OPENMP
+        if (workspace != NULL) {
+            workspace += (size_t)omp_get_thread_num() * similarity->thread_workspace;
+        }
+#endif
+        #pragma omp for schedule(static)
+        for (i = 0; i < rows; i++) {
+            row = out + (size_t)i * ld;
+            if (!similarity_distances(similarity->points, i0 + i, j0, cols, row, workspace)) {
+                #pragma omp atomic write
+                failed = 1;
+                continue;
+            }
+            scaled_exp(row, cols, -0.5);
+            if (i0 + i >= j0 && i0 + i < j0 + cols) {
+                row[i0 + i - j0] = 0.0;
+            }
+            if (similarity->inverse_sqrt != NULL) {
+                scale = similarity->inverse_sqrt->data + j0;
+                scale_i = similarity->inverse_sqrt->data[i0 + i];
+                for (j = 0; j < cols; j++) {
+                    row[j] = (scale_i * row[j]) * scale[j];
+                }
+            }
+        }
+    }
+    return !failed;
+}
+
+/* Function to multiply the streamed matrix by a dense one, mirroring the block loop of symm */
+int streaming_multiply(StreamingSimilarity *similarity, int k, const double *h, size_t ldh,
+                       double *c, size_t ldc, double *workspace) {
+    int n, i0, j0, rows, cols;
+    n = similarity->points->points->rows;
+    if (similarity->cache != NULL) {
+        rewind(similarity->cache);
+    }
+    for (i0 = 0; i0 < n; i0 += SYMM_BLOCK) {
+        rows = n - i0 < SYMM_BLOCK ? n - i0 : SYMM_BLOCK;
+        for (j0 = 0; j0 <= i0; j0 += SYMM_BLOCK) {
+            cols = n - j0 < SYMM_BLOCK ? n - j0 : SYMM_BLOCK;
+            if (!load_block(similarity, i0, rows, j0, cols)) {
+                return 0;
+            }
+            if (!gemm(rows, k, cols, similarity->block, (size_t)cols, 0, h + (size_t)j0 * ldh, ldh,
+                      c + (size_t)i0 * ldc, ldc, j0 > 0, workspace)) {
+                return 0;
+            }
+            if (j0 < i0 && !gemm(cols, k, rows, similarity->block, (size_t)cols, 1, h + (size_t)i0 * ldh, ldh,
+                                 c + (size_t)j0 * ldc, ldc, 1, workspace)) {
+                return 0;
+            }
+        }
+    }
+    if (similarity->cache != NULL) {
+        similarity->cache_ready = 1;
+    }
+    return 1;
+}
+
+/* Function to compute the mean of the streamed matrix from its lower-triangle blocks */
+double streaming_mean(StreamingSimilarity *similarity) {
+    int n, i0, j0, rows, cols, i, j;
+    double sum, block_sum;
+    n = similarity->points->points->rows;
+    sum = 0.0;
+    for (i0 = 0; i0 < n; i0 += SYMM_BLOCK) {
+        rows = n - i0 < SYMM_BLOCK ? n - i0 : SYMM_BLOCK;
+        for (j0 = 0; j0 <= i0; j0 += SYMM_BLOCK) {
+            cols = n - j0 < SYMM_BLOCK ? n - j0 : SYMM_BLOCK;
+            if (!streaming_block(similarity, i0, rows, j0, cols, similarity->block, (size_t)cols)) {
+                return -1.0;
+            }
+            block_sum = 0.0;
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < cols; j++) {
+                    block_sum += similarity->block[(size_t)i * cols + j];
+                }
+            }
+            /* Off-diagonal blocks also stand for their mirror image in the upper triangle */
+            sum += j0 < i0 ? 2.0 * block_sum : block_sum;
+        }
+    }
+    return sum / ((double)n * (double)n);
+}
+
+/* Function to print the streamed matrix a few full rows at a time */
+int print_streaming_matrix(StreamingSimilarity *similarity) {
+    int n, i0;
+    Matrix rows;
+    n = similarity->points->points->rows;
+    rows.cols = n;
+    rows.stride = matrix_stride(n);
+    rows.mapping = NULL;
+    rows.data = allocate_matrix_data(STREAMING_PRINT_ROWS, rows.stride);
+    if (rows.data == NULL) {
+        return 0;
+    }
+    for (i0 = 0; i0 < n; i0 += STREAMING_PRINT_ROWS) {
+        rows.rows = n - i0 < STREAMING_PRINT_ROWS ? n - i0 : STREAMING_PRINT_ROWS;
+        if (!streaming_block(similarity, i0, rows.rows, 0, n, rows.data, (size_t)rows.stride)) {
+            free(rows.data);
+            return 0;
+        }
+        print_matrix(&rows);
+    }
+    free(rows.data);
+    return 1;
+}
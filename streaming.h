@@ -0,0 +1,56 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <stdio.h>
+#include "symnmf.h"
+
+/* Rows of the similarity matrix computed at once when a streamed matrix is printed */
+#define STREAMING_PRINT_ROWS 16
+
+/* A similarity matrix that is never stored: blocks of it are recomputed from the points
+ * (and, for the normalized matrix, the degree vector) whenever they are needed, with the
+ * same kernels as sym and norm, so every entry is bit-for-bit the one they produce.
+ * Memory use is O(nd) for the points plus one SYMM_BLOCK x SYMM_BLOCK block and, for wide
+ * points, one gemm workspace per thread. */
+typedef struct StreamingSimilarity {
+    SimilarityPoints *points;
+    Vector *inverse_sqrt;   /* D^-1/2 of the normalized matrix, or NULL for sym */
+    double *block;          /* the block of W being multiplied */
+    double *workspace;      /* gemm packing buffers of the distance kernel, one slice per thread,
+                             * or NULL for points too narrow to use gemm */
+    size_t thread_workspace; /* doubles in each thread's slice of workspace */
+    int threads;            /* threads the blocks are computed on, fixed at creation */
+    FILE *cache;            /* optional file the lower-triangle blocks are kept in */
+    int cache_ready;        /* 1 once every block has been written to the cache */
+} StreamingSimilarity;
+
+/* Prepares the streamed similarity matrix of the points: the normalized matrix of norm when
+ * normalized is non-zero, the matrix of sym otherwise. When cache_file_name is not NULL the
+ * blocks computed by the first product are written to that file and read back by later ones.
+ * The points are borrowed and must outlive the streamed matrix. */
+StreamingSimilarity* create_streaming_similarity(Matrix *matrix, int normalized, const char *cache_file_name);
+
+/* Frees a streamed similarity matrix and closes its cache file */
+void free_streaming_similarity(StreamingSimilarity *similarity);
+
+/* Computes rows [i0, i0 + rows) and columns [j0, j0 + cols) of the matrix into out (leading dimension ld) */
+int streaming_block(StreamingSimilarity *similarity, int i0, int rows, int j0, int cols, double *out, size_t ld);
+
+/* Computes C = W * H for the streamed W, walking its lower triangle in the same blocks and order
+ * as symm so the result is identical. workspace must hold symm_workspace_size(n, k) doubles, or be NULL. */
+int streaming_multiply(StreamingSimilarity *similarity, int k, const double *h, size_t ldh,
+                       double *c, size_t ldc, double *workspace);
+
+/* Computes the mean of all entries of the streamed matrix; returns -1 on failure */
+double streaming_mean(StreamingSimilarity *similarity);
+
+/* Prints the streamed matrix in the format of print_matrix, STREAMING_PRINT_ROWS rows at a time */
+int print_streaming_matrix(StreamingSimilarity *similarity);
+
+/* Creates a solver whose W * H products recompute the streamed W; H is copied, W is borrowed */
+SymnmfSolver* create_streaming_symnmf_solver(Matrix *H, StreamingSimilarity *W);
+
+/* Performs the SYM-NMF algorithm without ever storing W */
+Matrix* streaming_symnmf(Matrix *H, StreamingSimilarity *W);
+
+#endif
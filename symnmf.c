@@ -1,121 +1,106 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 #include "symnmf.h"
+#include "gemm.h"
+#include "vecmath.h"
+#include "sparse.h"
+#include "streaming.h"
+#include "matrixio.h"
+#include "rng.h"
+#include "kmeans.h"
+#include "selection.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define DELIMITER ','
+#define SYM_TILE 64
 
-/* Helper function to allocate memory for the matrix data */
-double** allocate_matrix_data(int n, int d) {
-    double **data;
-    int i, j;
-    data = (double **)malloc(n * sizeof(double *));
-    if (data == NULL) {
-        return NULL;
-    }
-    for (i = 0; i < n; i++) {
-        data[i] = (double *)malloc(d * sizeof(double));
-        if (data[i] == NULL) {
-            for (j = 0; j < i; j++) {
-                free(data[j]);
-            }
-            free(data);
-            return NULL;
-        }
-    }
-    return data;
-}
+/* Per block of SYMM_BLOCK rows of H the solver keeps a partial k x k Gram matrix followed by
+ * partial sums of the squared update distance and the squared norm */
+#define BLOCK_SUMS_SIZE(k) ((size_t)(k) * (k) + 2)
 
-/* Helper function to read matrix data from file */
-int read_matrix_data(FILE *file, double **data, int n, int d) {
-    int i, j;
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < d; j++) {
-            if (fscanf(file, "%lf,", &data[i][j]) != 1) {
-                return 0;
-            }
-        }
-    }
-    return 1;
-}
+/* Rows of H the coordinate descent rule updates before it brings W * H up to date with gemm */
+#define COORDINATE_BLOCK 32
 
-/* Helper function to count rows and columns in the file */
-void count_rows_and_columns(FILE *file, int *n, int *d) {
-    int ch;
-    *n = 0;
-    *d = 0;
-    while ((ch = fgetc(file)) != EOF) {
-        if (ch == '\n') {
-            (*n)++;
-        } else if ((ch == ',') && (*n == 0)) {
-            (*d)++;
-        }
-    }
-    (*d)++;
-    rewind(file);
-}
+/* The ANLS rule weighs its penalty by ANLS_PENALTY times the largest diagonal entry of the initial
+ * H^T H. A row subproblem makes at most ANLS_MAX_PIVOTS exchanges, ANLS_BACKUP of them without
+ * progress before it falls back to single exchanges. It needs ANLS_SCRATCH(k) doubles of scratch
+ * and k more for its right-hand side. */
+#define ANLS_PENALTY 20.0
+#define ANLS_MAX_PIVOTS(k) (10 * (k) + 10)
+#define ANLS_BACKUP 3
+#define ANLS_SCRATCH(k) ((size_t)(k) * (k) + 3 * (size_t)(k))
 
-/* Function to handle cleanup of matrix data */
-void cleanup_matrix_data(double **data, int n) {
-    int i;
-    for (i = 0; i < n; i++) {
-        free(data[i]);
-    }
-    free(data);
-}
+/* Command-line options of the symnmf executable */
+typedef struct CliOptions {
+    char *goal;
+    char *file_name;
+    int threads;
+    int neighbors;
+    double radius;
+    int streaming;
+    char *output;
+    int k;                  /* number of clusters of the symnmf and kmeans goals */
+    unsigned long seed;     /* seed of the initial H of the symnmf goal */
+    SymnmfOptions symnmf;   /* update rule, stopping rule and log of the symnmf goal */
+    KmeansAlgorithm kmeans_algorithm; /* assignment step of the kmeans goal */
+    int batch_size;         /* points per batch of a mini-batch kmeans goal, 0 for full batch */
+    int k_min;              /* smallest k of the select goal, which sweeps k_min .. k */
+    int restarts;           /* runs per k of the select goal */
+    int silhouette_sample;  /* points sampled to score a run of the select goal, 0 for all */
+    int verify;             /* check the checksum of a binary input file */
+} CliOptions;
 
-/* Function to handle file reading errors */
-Matrix* handle_file_read_error(FILE *file, double **data, int n) {
-    fclose(file);
-    cleanup_matrix_data(data, n);
-    return NULL;
+/* Helper function to compute the padded row length (in doubles) for a given number of columns */
+int matrix_stride(int cols) {
+    int per_line = MATRIX_ALIGNMENT / (int)sizeof(double);
+    return ((cols + per_line - 1) / per_line) * per_line;
 }
 
-/* Function to load a matrix from a file */
-Matrix* load_matrix_from_file(const char *file_name) {
-    int n = 0, d = 0;
-    double **data = NULL;
-    FILE *file = NULL;
-    Matrix *matrix = NULL;
-    
-    file = fopen(file_name, "r");
-    if (file == NULL) {
+/* Helper function to allocate one aligned, zero-filled buffer for the matrix data */
+double* allocate_matrix_data(int rows, int stride) {
+    void *data = NULL;
+    size_t count, bytes;
+    if (rows < 0 || stride < 0) {
         return NULL;
     }
-    count_rows_and_columns(file, &n, &d);
-    data = allocate_matrix_data(n, d);
-    if (data == NULL) {
-        fclose(file);
+    count = (size_t)rows * (size_t)stride;
+    if (stride != 0 && count / (size_t)stride != (size_t)rows) {
         return NULL;
     }
-    if (!read_matrix_data(file, data, n, d)) {
-        return handle_file_read_error(file, data, n);
+    if (count > ((size_t)-1) / sizeof(double)) {
+        return NULL;
     }
-    fclose(file);
-    matrix = (Matrix *)malloc(sizeof(Matrix));
-    if (matrix == NULL) {
-        cleanup_matrix_data(data, n);
+    bytes = count * sizeof(double);
+    if (bytes == 0) {
+        bytes = MATRIX_ALIGNMENT;
+    }
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, bytes) != 0) {
         return NULL;
     }
-    matrix->rows = n;
-    matrix->cols = d;
-    matrix->data = data;
-    return matrix;
+    memset(data, 0, bytes);
+    return (double *)data;
+}
+
+/* Function to load a matrix from a file */
+Matrix* load_matrix_from_file(const char *file_name) {
+    long error_line;
+    return read_matrix_file(file_name, 1, &error_line);
 }
 
 /* Function to free the memory allocated for a matrix */
 void free_matrix(Matrix *matrix) {
-    int i;
     if (matrix == NULL) {
         return;
     }
-    if (matrix->data != NULL) {
-        for (i = 0; i < matrix->rows; i++) {
-            if (matrix->data[i] != NULL) {
-                free(matrix->data[i]);
-            }
-        }
+    if (matrix->mapping != NULL) {
+        unmap_matrix_file(matrix->mapping, matrix->mapping_length);
+    } else {
         free(matrix->data);
     }
     free(matrix);
@@ -123,28 +108,60 @@ void free_matrix(Matrix *matrix) {
 
 /* Function to initialize a matrix with zeros */
 Matrix* initialize_matrix_with_zeros(int rows, int cols) {
-    int i, j;
     Matrix *matrix = (Matrix *)malloc(sizeof(Matrix));
     if (matrix == NULL) {
         return NULL;
     }
     matrix->rows = rows;
     matrix->cols = cols;
-    matrix->data = (double **)malloc(rows * sizeof(double *));
+    matrix->stride = matrix_stride(cols);
+    matrix->mapping = NULL;
+    matrix->mapping_length = 0;
+    matrix->data = allocate_matrix_data(rows, matrix->stride);
     if (matrix->data == NULL) {
         free(matrix);
         return NULL;
     }
-    for (i = 0; i < rows; i++) {
-        matrix->data[i] = (double *)calloc(cols, sizeof(double));
-        if (matrix->data[i] == NULL) {
-            for (j = 0; j < i; j++) {
-                free(matrix->data[j]);
-            }
-            free(matrix->data);
-            free(matrix);
-            return NULL;
-        }
+    return matrix;
+}
+
+/* Function to initialize a vector with zeros */
+Vector* initialize_vector_with_zeros(int length) {
+    Vector *vector = (Vector *)malloc(sizeof(Vector));
+    if (vector == NULL) {
+        return NULL;
+    }
+    vector->length = length;
+    vector->data = allocate_matrix_data(1, length);
+    if (vector->data == NULL) {
+        free(vector);
+        return NULL;
+    }
+    return vector;
+}
+
+/* Function to free the memory allocated for a vector */
+void free_vector(Vector *vector) {
+    if (vector == NULL) {
+        return;
+    }
+    free(vector->data);
+    free(vector);
+}
+
+/* Function to expand a diagonal stored as a vector into a dense square matrix */
+Matrix* diagonal_to_matrix(Vector *diagonal) {
+    int i;
+    Matrix *matrix;
+    if (diagonal == NULL) {
+        return NULL;
+    }
+    matrix = initialize_matrix_with_zeros(diagonal->length, diagonal->length);
+    if (matrix == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < diagonal->length; i++) {
+        MATRIX_ROW(matrix, i)[i] = diagonal->data[i];
     }
     return matrix;
 }
@@ -160,59 +177,249 @@ double euclidean_distance(double *vec1, double *vec2, int length) {
     return sum;
 }
 
-/* Function to compute the symmetric similarity matrix */
+/* Helper function to map a flat index onto the tiles of a lower triangle, numbered row by row */
+void triangle_tile_coordinates(long index, int *tile_row, int *tile_col) {
+    long row = (long)((sqrt(8.0 * (double)index + 1.0) - 1.0) / 2.0);
+    while (row * (row + 1) / 2 > index) {
+        row--;
+    }
+    while ((row + 1) * (row + 2) / 2 <= index) {
+        row++;
+    }
+    *tile_row = (int)row;
+    *tile_col = (int)(index - row * (row + 1) / 2);
+}
+
+/* Function to prepare points for the similarity kernels */
+SimilarityPoints* prepare_similarity_points(Matrix *matrix) {
+    int i, c;
+    double norm, *point;
+    SimilarityPoints *points = (SimilarityPoints *)calloc(1, sizeof(SimilarityPoints));
+    if (points == NULL) {
+        return NULL;
+    }
+    points->points = matrix;
+    points->coordinates = transpose(matrix);
+    points->squared_norms = initialize_vector_with_zeros(matrix->rows);
+    if (points->coordinates == NULL || points->squared_norms == NULL) {
+        free_similarity_points(points);
+        return NULL;
+    }
+    for (i = 0; i < matrix->rows; i++) {
+        point = MATRIX_ROW(matrix, i);
+        norm = 0.0;
+        for (c = 0; c < matrix->cols; c++) {
+            norm += point[c] * point[c];
+        }
+        points->squared_norms->data[i] = norm;
+    }
+    return points;
+}
+
+/* Function to free prepared points; the original points matrix is left alone */
+void free_similarity_points(SimilarityPoints *points) {
+    if (points == NULL) {
+        return;
+    }
+    free_matrix(points->coordinates);
+    free_vector(points->squared_norms);
+    free(points);
+}
+
+/* Function to compute the squared distances from point i to the count points starting at point j0.
+ * Wide points use ||x||^2 + ||y||^2 - 2 x.y with the dot products from gemm; narrow points use
+ * the vectorized direct kernel. workspace is scratch for gemm and may be NULL. */
+int similarity_distances(SimilarityPoints *points, int i, int j0, int count, double *out, double *workspace) {
+    int d, j;
+    double distance, *norms;
+    Matrix *coordinates = points->coordinates;
+    d = points->points->cols;
+    if (count <= 0) {
+        return 1;
+    }
+    if (d < SYM_GEMM_MIN_DIM) {
+        squared_distances(MATRIX_ROW(points->points, i), coordinates->data + j0, (size_t)coordinates->stride,
+                          count, d, out);
+        return 1;
+    }
+    if (!gemm(1, count, d, MATRIX_ROW(points->points, i), (size_t)points->points->stride, 0,
+              coordinates->data + j0, (size_t)coordinates->stride, out, (size_t)count, 0, workspace)) {
+        return 0;
+    }
+    norms = points->squared_norms->data;
+    for (j = 0; j < count; j++) {
+        distance = norms[i] + norms[j0 + j] - 2.0 * out[j];
+        out[j] = distance > 0 ? distance : 0;
+    }
+    return 1;
+}
+
+/* Helper function to fill one SYM_TILE x SYM_TILE tile of the lower triangle of the similarity
+ * matrix and mirror it into the upper triangle while the tile is still in cache */
+int fill_similarity_tile(SimilarityPoints *points, Matrix *similarity_matrix, int tile_row, int tile_col,
+                         double *workspace) {
+    int n, d, i, j, i0, j0, i_end, j_end, count;
+    double distance, *row, *norms = NULL;
+    Matrix *matrix = points->points;
+    n = matrix->rows;
+    d = matrix->cols;
+    i0 = tile_row * SYM_TILE;
+    j0 = tile_col * SYM_TILE;
+    i_end = i0 + SYM_TILE < n ? i0 + SYM_TILE : n;
+    j_end = j0 + SYM_TILE < n ? j0 + SYM_TILE : n;
+    if (d >= SYM_GEMM_MIN_DIM) {
+        /* One gemm gives the dot products of the whole tile */
+        if (!gemm(i_end - i0, j_end - j0, d, MATRIX_ROW(matrix, i0), (size_t)matrix->stride, 0,
+                  points->coordinates->data + j0, (size_t)points->coordinates->stride,
+                  MATRIX_ROW(similarity_matrix, i0) + j0, (size_t)similarity_matrix->stride, 0, workspace)) {
+            return 0;
+        }
+        norms = points->squared_norms->data;
+    }
+    for (i = i0; i < i_end; i++) {
+        row = MATRIX_ROW(similarity_matrix, i);
+        count = (j_end < i ? j_end : i) - j0;
+        if (d >= SYM_GEMM_MIN_DIM) {
+            for (j = j0; j < j0 + count; j++) {
+                distance = norms[i] + norms[j] - 2.0 * row[j];
+                row[j] = distance > 0 ? distance : 0;
+            }
+        } else if (count > 0) {
+            squared_distances(MATRIX_ROW(matrix, i), points->coordinates->data + j0,
+                              (size_t)points->coordinates->stride, count, d, row + j0);
+        }
+        if (count > 0) {
+            scaled_exp(row + j0, count, -0.5);
+        }
+        if (tile_row == tile_col) {
+            row[i] = 0.0;
+        }
+    }
+    for (j = j0; j < j_end; j++) {
+        row = MATRIX_ROW(similarity_matrix, j);
+        for (i = (i0 > j + 1 ? i0 : j + 1); i < i_end; i++) {
+            row[i] = MATRIX_ROW(similarity_matrix, i)[j];
+        }
+    }
+    return 1;
+}
+
+/* Function to compute the symmetric similarity matrix.
+ * The lower triangle is cut into square tiles that are handed out dynamically to the threads;
+ * all off-diagonal tiles cost the same, so the triangular shape does not unbalance the work. */
 Matrix* sym(Matrix *matrix) {
-    int n, i, j;
-    double distance;
+    int n, tiles_per_side, tile_row, tile_col, failed;
+    long tile, tile_count;
+    double *workspace;
+    SimilarityPoints *points;
     Matrix *similarity_matrix;
     if (matrix == NULL) {
         return NULL;
     }
     n = matrix->rows;
+    points = prepare_similarity_points(matrix);
     similarity_matrix = initialize_matrix_with_zeros(n, n);
-    if (similarity_matrix == NULL) {
+    if (points == NULL || similarity_matrix == NULL) {
+        free_similarity_points(points);
+        free_matrix(similarity_matrix);
         return NULL;
     }
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < i; j++) {
-            distance = euclidean_distance(matrix->data[i], matrix->data[j], matrix->cols);
-            similarity_matrix->data[i][j] = exp(-0.5 * distance);
-            similarity_matrix->data[j][i] = similarity_matrix->data[i][j];
+    tiles_per_side = (n + SYM_TILE - 1) / SYM_TILE;
+    tile_count = (long)tiles_per_side * (tiles_per_side + 1) / 2;
+    failed = 0;
+    #pragma omp parallel private(tile, tile_row, tile_col, workspace)
+    {
+        workspace = NULL;
+        if (matrix->cols >= SYM_GEMM_MIN_DIM) {
+            workspace = allocate_matrix_data(1, (int)gemm_workspace_size(SYM_TILE, SYM_TILE, matrix->cols));
         }
-        similarity_matrix->data[i][i] = 0.0;
+        #pragma omp for schedule(dynamic)
+        for (tile = 0; tile < tile_count; tile++) {
+            triangle_tile_coordinates(tile, &tile_row, &tile_col);
+            if (!fill_similarity_tile(points, similarity_matrix, tile_row, tile_col, workspace)) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        free(workspace);
+    }
+    free_similarity_points(points);
+    if (failed) {
+        free_matrix(similarity_matrix);
+        return NULL;
     }
     return similarity_matrix;
 }
 
-/* Function to compute the diagonal degree matrix */
-Matrix* ddg(Matrix *matrix) {
+/* Function to compute the degree of every point, i.e. the row sums of a similarity matrix */
+Vector* compute_degrees(Matrix *sym_matrix) {
     int n, i, j;
-    Matrix *sym_matrix, *diagonal_matrix;
-    if (matrix == NULL) {
+    double degree, *sym_row;
+    Vector *degrees;
+    n = sym_matrix->rows;
+    degrees = initialize_vector_with_zeros(n);
+    if (degrees == NULL) {
         return NULL;
     }
-    sym_matrix = sym(matrix);
-    if (sym_matrix == NULL) {
+    for (i = 0; i < n; i++) {
+        sym_row = MATRIX_ROW(sym_matrix, i);
+        degree = 0.0;
+        for (j = 0; j < n; j++) {
+            degree += sym_row[j];
+        }
+        degrees->data[i] = degree;
+    }
+    return degrees;
+}
+
+/* Function to compute the diagonal of the degree matrix straight from the points.
+ * The similarity values are summed as they are produced, so only O(n) extra memory is used;
+ * every degree still receives its terms in ascending column order, as a row sum of sym would. */
+Vector* ddg(Matrix *matrix) {
+    int n, i, j;
+    double *degrees, *similarities, *workspace = NULL;
+    SimilarityPoints *points;
+    Vector *diagonal;
+    if (matrix == NULL) {
         return NULL;
     }
     n = matrix->rows;
-    diagonal_matrix = initialize_matrix_with_zeros(n, n);
-    if (diagonal_matrix == NULL) {
-        free_matrix(sym_matrix); 
+    points = prepare_similarity_points(matrix);
+    diagonal = initialize_vector_with_zeros(n);
+    similarities = allocate_matrix_data(1, n);
+    if (matrix->cols >= SYM_GEMM_MIN_DIM) {
+        /* One gemm workspace for every row, sized for the longest one */
+        workspace = allocate_matrix_data(1, (int)gemm_workspace_size(1, n, matrix->cols));
+    }
+    if (points == NULL || diagonal == NULL || similarities == NULL
+        || (matrix->cols >= SYM_GEMM_MIN_DIM && workspace == NULL)) {
+        free_similarity_points(points);
+        free_vector(diagonal);
+        free(similarities);
+        free(workspace);
         return NULL;
     }
+    degrees = diagonal->data;
     for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            diagonal_matrix->data[i][i] += sym_matrix->data[i][j];
+        if (!similarity_distances(points, i, 0, i, similarities, workspace)) {
+            free_vector(diagonal);
+            diagonal = NULL;
+            break;
+        }
+        scaled_exp(similarities, i, -0.5);
+        for (j = 0; j < i; j++) {
+            degrees[i] += similarities[j];
+            degrees[j] += similarities[j];
         }
     }
-    free_matrix(sym_matrix); 
-    return diagonal_matrix;
+    free(similarities);
+    free(workspace);
+    free_similarity_points(points);
+    return diagonal;
 }
 
 /* Function to multiply two matrices */
 Matrix* multiply_matrices(Matrix *matrix1, Matrix *matrix2) {
-    int rows, cols, common_dim, i, j, k;
     Matrix *result_matrix;
     if (matrix1 == NULL || matrix2 == NULL) {
         return NULL;
@@ -220,194 +427,1458 @@ Matrix* multiply_matrices(Matrix *matrix1, Matrix *matrix2) {
     if (matrix1->cols != matrix2->rows) {
         return NULL;
     }
-    rows = matrix1->rows;
-    cols = matrix2->cols;
-    common_dim = matrix1->cols;
-    result_matrix = initialize_matrix_with_zeros(rows, cols);
+    result_matrix = initialize_matrix_with_zeros(matrix1->rows, matrix2->cols);
     if (result_matrix == NULL) {
         return NULL;
     }
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            for (k = 0; k < common_dim; k++) {
-                result_matrix->data[i][j] += matrix1->data[i][k] * matrix2->data[k][j];
-            }
-        }
+    if (!gemm(matrix1->rows, matrix2->cols, matrix1->cols, matrix1->data, (size_t)matrix1->stride, 0,
+              matrix2->data, (size_t)matrix2->stride, result_matrix->data, (size_t)result_matrix->stride, 0, NULL)) {
+        free_matrix(result_matrix);
+        return NULL;
     }
     return result_matrix;
 }
 
-/* Function to compute the inverse square root of a matrix */
-Matrix* compute_inverse_sqrt(Matrix *matrix) {
-    int rows, cols, i, j;
+/* Function to multiply a symmetric matrix by another matrix, reading only its lower triangle */
+Matrix* multiply_symmetric(Matrix *symmetric, Matrix *matrix) {
+    Matrix *result_matrix;
+    if (symmetric == NULL || matrix == NULL) {
+        return NULL;
+    }
+    if (symmetric->rows != symmetric->cols || symmetric->cols != matrix->rows) {
+        return NULL;
+    }
+    result_matrix = initialize_matrix_with_zeros(symmetric->rows, matrix->cols);
+    if (result_matrix == NULL) {
+        return NULL;
+    }
+    if (!symm(symmetric->rows, matrix->cols, symmetric->data, (size_t)symmetric->stride,
+              matrix->data, (size_t)matrix->stride, result_matrix->data, (size_t)result_matrix->stride, NULL)) {
+        free_matrix(result_matrix);
+        return NULL;
+    }
+    return result_matrix;
+}
+
+/* Function to compute the Gram matrix M^T * M of a matrix */
+Matrix* gram_matrix(Matrix *matrix) {
     Matrix *result_matrix;
     if (matrix == NULL) {
         return NULL;
     }
-    rows = matrix->rows;
-    cols = matrix->cols;
-    result_matrix = initialize_matrix_with_zeros(rows, cols);
+    result_matrix = initialize_matrix_with_zeros(matrix->cols, matrix->cols);
     if (result_matrix == NULL) {
         return NULL;
     }
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            if (matrix->data[i][j] != 0) {
-                result_matrix->data[i][j] = 1.0 / sqrt(matrix->data[i][j]);
-            } else {
-                result_matrix->data[i][j] = 0;
-            }
+    syrk(matrix->rows, matrix->cols, matrix->data, (size_t)matrix->stride,
+         result_matrix->data, (size_t)result_matrix->stride);
+    return result_matrix;
+}
+
+/* Function to compute the inverse square root of a diagonal matrix, leaving zero entries at zero */
+Vector* compute_inverse_sqrt(Vector *diagonal) {
+    int i;
+    Vector *result;
+    if (diagonal == NULL) {
+        return NULL;
+    }
+    result = initialize_vector_with_zeros(diagonal->length);
+    if (result == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < diagonal->length; i++) {
+        if (diagonal->data[i] != 0) {
+            result->data[i] = 1.0 / sqrt(diagonal->data[i]);
+        }
+    }
+    return result;
+}
+
+/* Function to scale a similarity matrix in place to D^-1/2 * A * D^-1/2, given the diagonal of D^-1/2 */
+void normalize_similarity(Matrix *sym_matrix, Vector *inverse_sqrt) {
+    int n, i, j;
+    double scale_i, *row, *scale;
+    n = sym_matrix->rows;
+    scale = inverse_sqrt->data;
+    for (i = 0; i < n; i++) {
+        row = MATRIX_ROW(sym_matrix, i);
+        scale_i = scale[i];
+        for (j = 0; j < n; j++) {
+            row[j] = (scale_i * row[j]) * scale[j];
         }
     }
-    return result_matrix;
 }
 
 /* Function to compute the normalized matrix */
 Matrix* norm(Matrix *matrix) {
-    Matrix *sym_matrix, *ddg_matrix, *inv_sqrt_matrix, *temp_matrix, *result_matrix;
+    Vector *degrees, *inverse_sqrt;
+    Matrix *sym_matrix;
     if (matrix == NULL) return NULL;
     sym_matrix = sym(matrix);
-    ddg_matrix = ddg(matrix);
-    inv_sqrt_matrix = compute_inverse_sqrt(ddg_matrix);
-    temp_matrix = multiply_matrices(inv_sqrt_matrix, sym_matrix);
-    result_matrix = multiply_matrices(temp_matrix, inv_sqrt_matrix);
-    free_matrix(sym_matrix);
-    free_matrix(ddg_matrix);
-    free_matrix(inv_sqrt_matrix);
-    free_matrix(temp_matrix);
-    return result_matrix;
+    if (sym_matrix == NULL) {
+        return NULL;
+    }
+    degrees = compute_degrees(sym_matrix);
+    inverse_sqrt = compute_inverse_sqrt(degrees);
+    free_vector(degrees);
+    if (inverse_sqrt == NULL) {
+        free_matrix(sym_matrix);
+        return NULL;
+    }
+    normalize_similarity(sym_matrix, inverse_sqrt);
+    free_vector(inverse_sqrt);
+    return sym_matrix;
 }
 
-/* Function to update matrix H in the SYM-NMF algorithm */
-Matrix* update(Matrix* H, Matrix* W) {
-    int n, k, i, j;
-    double b;
-    Matrix* WH, *Ht, *HHt, *HHtH, *next_h;
-    n = W->rows;
-    k = H->cols;
-    WH = multiply_matrices(W, H);
-    Ht = transpose(H);
-    HHt = multiply_matrices(H, Ht);
-    HHtH = multiply_matrices(HHt, H);
-    next_h = initialize_matrix_with_zeros(n, k);
-    b = 0.5;
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < k; j++) {
-            next_h->data[i][j] = H->data[i][j] * (b + b * (WH->data[i][j] / HHtH->data[i][j]));
-        }
-    }
-    free_matrix(WH);
-    free_matrix(Ht);
-    free_matrix(HHt);
-    free_matrix(HHtH);
-    return next_h;
+/* Helper function to report how many threads a parallel region started now would get */
+static int available_threads(void) {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
 }
 
-/* Function to perform the SYM-NMF algorithm */
-Matrix* symnmf(Matrix *H, Matrix *W) {
-    int iter, n, k, i, j;
-    double eps;
-    Matrix* next_H;
-    iter = 0;
-    eps = 0.0001;
+/* Helper function to find the calling thread's slice of the solver workspace */
+static double* thread_workspace(SymnmfSolver *solver) {
+#ifdef _OPENMP
+    return solver->workspace + (size_t)omp_get_thread_num() * solver->thread_workspace;
+#else
+    return solver->workspace;
+#endif
+}
+
+/* Helper function to allocate a solver for an n x k iterate, copying the initial H */
+static SymnmfSolver* allocate_symnmf_solver(Matrix *H, Matrix *W, SparseMatrix *sparse_W,
+                                            StreamingSimilarity *streaming_W) {
+    int n, k, i, blocks;
+    size_t workspace_size;
+    SymnmfSolver *solver;
     n = H->rows;
     k = H->cols;
-    while (iter < 300) {
-        next_H = update(H, W);
-        if (pow(frobidean_distance(H, next_H), 2) < eps) {
-            return next_H;
-        }
-        for (i = 0; i < n; i++) {
-            for (j = 0; j < k; j++) {
-                H->data[i][j] = next_H->data[i][j];
-            }
-        }
-        free_matrix(next_H);
-        iter++;
+    solver = (SymnmfSolver *)calloc(1, sizeof(SymnmfSolver));
+    if (solver == NULL) {
+        return NULL;
+    }
+    solver->W = W;
+    solver->sparse_W = sparse_W;
+    solver->streaming_W = streaming_W;
+    solver->H = initialize_matrix_with_zeros(n, k);
+    solver->next_H = initialize_matrix_with_zeros(n, k);
+    solver->WH = initialize_matrix_with_zeros(n, k);
+    solver->HtH = initialize_matrix_with_zeros(k, k);
+    solver->HHtH = initialize_matrix_with_zeros(n, k);
+    workspace_size = sparse_W != NULL ? 0 : symm_workspace_size(n, k);
+    if (gemm_workspace_size(n, k, k) > workspace_size) {
+        workspace_size = gemm_workspace_size(n, k, k);
+    }
+    if (gemm_workspace_size(n, k, COORDINATE_BLOCK) > workspace_size) {
+        workspace_size = gemm_workspace_size(n, k, COORDINATE_BLOCK);
+    }
+    if (ANLS_SCRATCH(k) + (size_t)k > workspace_size) {
+        workspace_size = ANLS_SCRATCH(k) + (size_t)k;
+    }
+    /* Slices start on 64-byte boundaries, like the buffer as a whole */
+    solver->thread_workspace = (workspace_size + 7) / 8 * 8;
+    solver->threads = available_threads();
+    solver->workspace = allocate_matrix_data(solver->threads, (int)solver->thread_workspace);
+    blocks = (n + SYMM_BLOCK - 1) / SYMM_BLOCK;
+    solver->block_sums = allocate_matrix_data(blocks, (int)BLOCK_SUMS_SIZE(k));
+    if (solver->H == NULL || solver->next_H == NULL || solver->WH == NULL || solver->HtH == NULL
+        || solver->HHtH == NULL || solver->workspace == NULL || solver->block_sums == NULL) {
+        free_symnmf_solver(solver);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        memcpy(MATRIX_ROW(solver->H, i), MATRIX_ROW(H, i), (size_t)k * sizeof(double));
     }
-    return next_H;
+    return solver;
 }
 
-/* Function to print a matrix with specific formatting */
-void print_matrix(Matrix *matrix) {
-    int i, j;
-    for (i = 0; i < matrix->rows; i++) {
-        for (j = 0; j < matrix->cols; j++) {
-            printf("%.4f", matrix->data[i][j]);
-            if (j < matrix->cols - 1) {
-                printf(","); 
-            }
-        }
-        printf("\n"); 
+/* Function to create a SYM-NMF solver, copying the initial H and allocating all iteration workspace */
+SymnmfSolver* create_symnmf_solver(Matrix *H, Matrix *W) {
+    if (H == NULL || W == NULL || W->rows != W->cols || H->rows != W->rows) {
+        return NULL;
     }
+    return allocate_symnmf_solver(H, W, NULL, NULL);
 }
 
-/* Function to calculate the Frobenius distance between two matrices */
-double frobidean_distance(Matrix* mat1, Matrix* mat2) {
-    double d = 0.0;
-    int i, j;
-    int rows = mat1->rows;
-    int cols = mat1->cols;
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            d += (mat1->data[i][j] - mat2->data[i][j]) * (mat1->data[i][j] - mat2->data[i][j]);
-        }
+/* Function to create a SYM-NMF solver whose W * H products use a sparse W */
+SymnmfSolver* create_sparse_symnmf_solver(Matrix *H, SparseMatrix *W) {
+    if (H == NULL || W == NULL || W->rows != W->cols || H->rows != W->rows) {
+        return NULL;
     }
-    return sqrt(d);
+    return allocate_symnmf_solver(H, NULL, W, NULL);
 }
 
-/* Function to transpose a matrix */
-Matrix* transpose(Matrix* matrix) {
-    int rows, cols, i, j;
-    Matrix* transposed_matrix;
-    if (matrix == NULL) {
+/* Function to create a SYM-NMF solver that recomputes W inside every W * H product */
+SymnmfSolver* create_streaming_symnmf_solver(Matrix *H, StreamingSimilarity *W) {
+    if (H == NULL || W == NULL || H->rows != W->points->points->rows) {
         return NULL;
     }
-    rows = matrix->rows;
-    cols = matrix->cols;
-    transposed_matrix = initialize_matrix_with_zeros(cols, rows);
-    if (transposed_matrix == NULL) {
-        return NULL;
+    return allocate_symnmf_solver(H, NULL, NULL, W);
+}
+
+/* Function to free a SYM-NMF solver and everything it owns */
+void free_symnmf_solver(SymnmfSolver *solver) {
+    if (solver == NULL) {
+        return;
     }
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            transposed_matrix->data[j][i] = matrix->data[i][j];
+    free_matrix(solver->H);
+    free_matrix(solver->next_H);
+    free_matrix(solver->WH);
+    free_matrix(solver->HtH);
+    free_matrix(solver->HHtH);
+    free_matrix(solver->G);
+    free_matrix(solver->Y);
+    free(solver->w_rows);
+    free(solver->workspace);
+    free(solver->block_sums);
+    free(solver);
+}
+
+/* Helper function to compute WP = W * P for the dense W, one block row of WP per thread at a time.
+ * Unlike symm every block of W is read twice, but the result is the same bit for bit. */
+static int parallel_symm(SymnmfSolver *solver, Matrix *P, Matrix *WP) {
+    int n = P->rows, k = P->cols, i0, failed = 0;
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(solver->threads)
+    for (i0 = 0; i0 < n; i0 += SYMM_BLOCK) {
+        if (!symm_block_row(n, k, solver->W->data, (size_t)solver->W->stride, P->data, (size_t)P->stride,
+                            i0, WP->data, (size_t)WP->stride, thread_workspace(solver))) {
+            #pragma omp atomic write
+            failed = 1;
         }
     }
-    return transposed_matrix;
+    return !failed;
 }
 
-/* Main function to execute the program based on command-line arguments */
-int main(int argc, char *argv[]) {
-    char *goal, *file_name;
-    Matrix *matrix, *result;
-    if (argc != 3) {
-        fprintf(stderr, "An Error Has Occurred\n");
+/* Helper function to compute WP = W * P for an n x k P with the solver's dense, sparse or streamed W */
+static int multiply_similarity(SymnmfSolver *solver, Matrix *P, Matrix *WP) {
+    int n = P->rows, k = P->cols;
+    if (solver->sparse_W != NULL) {
+        multiply_sparse(solver->sparse_W, P->data, (size_t)P->stride, k, WP->data, (size_t)WP->stride);
         return 1;
     }
-    goal = argv[1];
-    file_name = argv[2];
-    matrix = load_matrix_from_file(file_name);
-    if (matrix == NULL) {
-        fprintf(stderr, "An Error Has Occurred\n");
-        return 1;
+    if (solver->streaming_W != NULL) {
+        return streaming_multiply(solver->streaming_W, k, P->data, (size_t)P->stride,
+                                  WP->data, (size_t)WP->stride, solver->workspace);
     }
-    result = NULL;
-    if (strcmp(goal, "sym") == 0) {
-        result = sym(matrix);
-    } else if (strcmp(goal, "ddg") == 0) {
-        result = ddg(matrix);
-    } else if (strcmp(goal, "norm") == 0) {
-        result = norm(matrix);
-    } else {
-        fprintf(stderr, "An Error Has Occurred\n");
-        free_matrix(matrix);
-        return 1;
+    if (solver->threads == 1) {
+        return symm(n, k, solver->W->data, (size_t)solver->W->stride, P->data, (size_t)P->stride,
+                    WP->data, (size_t)WP->stride, solver->workspace);
     }
-    if (result != NULL) {
-        print_matrix(result);
-        free_matrix(result);
+    return parallel_symm(solver, P, WP);
+}
+
+/* Helper function to compute the products of a multiplicative update from the point P:
+ * WH = W * P, HtH = P^T * P and HHtH = P * (P^T * P) */
+static int multiplicative_products(SymnmfSolver *solver, Matrix *P) {
+    int n = P->rows, k = P->cols;
+    if (!multiply_similarity(solver, P, solver->WH)) {
+        return 0;
+    }
+    syrk(n, k, P->data, (size_t)P->stride, solver->HtH->data, (size_t)solver->HtH->stride);
+    return gemm(n, k, k, P->data, (size_t)P->stride, 0, solver->HtH->data, (size_t)solver->HtH->stride,
+                solver->HHtH->data, (size_t)solver->HHtH->stride, 0, solver->workspace);
+}
+
+/* Helper function to make the next iterate the current one, reusing the old one's buffer */
+static void swap_iterates(SymnmfSolver *solver) {
+    Matrix *swap = solver->H;
+    solver->H = solver->next_H;
+    solver->next_H = swap;
+}
+
+/* Helper function to sum the partial Gram matrices of the blocks of H, in block order, into HtH */
+static void reduce_gram(SymnmfSolver *solver, int blocks) {
+    int k = solver->HtH->cols, block, i, j;
+    double value;
+    for (i = 0; i < k; i++) {
+        for (j = 0; j < k; j++) {
+            value = solver->block_sums[(size_t)i * k + j];
+            for (block = 1; block < blocks; block++) {
+                value += solver->block_sums[block * BLOCK_SUMS_SIZE(k) + (size_t)i * k + j];
+            }
+            MATRIX_ROW(solver->HtH, i)[j] = value;
+        }
+    }
+}
+
+/* Helper function for the beta = 1/2 multiplicative rule. Each thread owns blocks of SYMM_BLOCK
+ * rows of H: it computes their partial Gram matrix, and once the k x k H^T * H is reduced, their
+ * rows of W * H (dense W) and H * (H^T * H), then updates them while they are still in cache.
+ * All sums are taken per block and combined in block order, so the result does not depend on
+ * the number of threads. */
+static double multiplicative_step(SymnmfSolver *solver) {
+    int n, k, blocks, block, i0, rows, i, j, fused, failed;
+    double b, distance, norm_squared, diff, block_distance, block_norm, *sums, *workspace;
+    double *h_row, *wh_row, *hhth_row, *next_row;
+    size_t stride;
+    Matrix *H = solver->H;
+    n = H->rows;
+    k = H->cols;
+    stride = (size_t)H->stride;
+    blocks = (n + SYMM_BLOCK - 1) / SYMM_BLOCK;
+    /* With several threads the dense W * H is computed block row by block row inside the pass
+     * below; a single thread is better served by symm, which reads W once instead of twice */
+    fused = solver->W != NULL && solver->threads > 1;
+    if (!fused && !multiply_similarity(solver, H, solver->WH)) {
+        return -1.0;
+    }
+    b = 0.5;
+    failed = 0;
+    #pragma omp parallel num_threads(solver->threads) private(block, i0, rows, i, j, diff, block_distance, \
+        block_norm, sums, workspace, h_row, wh_row, hhth_row, next_row)
+    {
+        workspace = thread_workspace(solver);
+        #pragma omp for schedule(static)
+        for (block = 0; block < blocks; block++) {
+            i0 = block * SYMM_BLOCK;
+            rows = n - i0 < SYMM_BLOCK ? n - i0 : SYMM_BLOCK;
+            syrk(rows, k, MATRIX_ROW(H, i0), stride, solver->block_sums + block * BLOCK_SUMS_SIZE(k), (size_t)k);
+        }
+        #pragma omp single
+        reduce_gram(solver, blocks);
+        #pragma omp for schedule(dynamic, 1)
+        for (block = 0; block < blocks; block++) {
+            i0 = block * SYMM_BLOCK;
+            rows = n - i0 < SYMM_BLOCK ? n - i0 : SYMM_BLOCK;
+            if ((fused && !symm_block_row(n, k, solver->W->data, (size_t)solver->W->stride, H->data, stride,
+                                          i0, solver->WH->data, (size_t)solver->WH->stride, workspace))
+                || !gemm(rows, k, k, MATRIX_ROW(H, i0), stride, 0, solver->HtH->data, (size_t)solver->HtH->stride,
+                         MATRIX_ROW(solver->HHtH, i0), (size_t)solver->HHtH->stride, 0, workspace)) {
+                #pragma omp atomic write
+                failed = 1;
+                continue;
+            }
+            block_distance = 0.0;
+            block_norm = 0.0;
+            for (i = i0; i < i0 + rows; i++) {
+                h_row = MATRIX_ROW(H, i);
+                wh_row = MATRIX_ROW(solver->WH, i);
+                hhth_row = MATRIX_ROW(solver->HHtH, i);
+                next_row = MATRIX_ROW(solver->next_H, i);
+                for (j = 0; j < k; j++) {
+                    next_row[j] = h_row[j] * (b + b * (wh_row[j] / hhth_row[j]));
+                    diff = next_row[j] - h_row[j];
+                    block_distance += diff * diff;
+                    block_norm += next_row[j] * next_row[j];
+                }
+            }
+            sums = solver->block_sums + block * BLOCK_SUMS_SIZE(k) + (size_t)k * k;
+            sums[0] = block_distance;
+            sums[1] = block_norm;
+        }
+    }
+    if (failed) {
+        return -1.0;
+    }
+    distance = 0.0;
+    norm_squared = 0.0;
+    for (block = 0; block < blocks; block++) {
+        sums = solver->block_sums + block * BLOCK_SUMS_SIZE(k) + (size_t)k * k;
+        distance += sums[0];
+        norm_squared += sums[1];
+    }
+    solver->norm_squared = norm_squared;
+    swap_iterates(solver);
+    return distance;
+}
+
+/* Helper function for the multiplicative rule applied at the extrapolated point
+ * Y = H_t + beta_t (H_t - H_t-1), beta_t = (t - 1) / (t + 2). Entries of Y are kept at or above
+ * half of H_t so that none is set to zero, where the multiplicative rule would leave it for good.
+ * The momentum restarts whenever f(Y) = ||Y^T Y||_F^2 - 2 tr(Y^T W Y), the objective up to
+ * the constant ||W||_F^2, increases. The previous iterate is kept in G. */
+static double nesterov_step(SymnmfSolver *solver) {
+    int n, k, i, j;
+    double beta, distance, norm_squared, objective, diff, y, *h_row, *previous_row, *y_row, *wy_row,
+           *yyty_row, *next_row, *yty_row;
+    Matrix *H, *swap;
+    H = solver->H;
+    n = H->rows;
+    k = H->cols;
+    beta = (solver->momentum_steps - 1.0) / (solver->momentum_steps + 2.0);
+    for (i = 0; i < n; i++) {
+        h_row = MATRIX_ROW(H, i);
+        previous_row = MATRIX_ROW(solver->G, i);
+        y_row = MATRIX_ROW(solver->Y, i);
+        for (j = 0; j < k; j++) {
+            y = h_row[j] + beta * (h_row[j] - previous_row[j]);
+            y_row[j] = y < 0.5 * h_row[j] ? 0.5 * h_row[j] : y;
+        }
+    }
+    if (!multiplicative_products(solver, solver->Y)) {
+        return -1.0;
+    }
+    objective = 0.0;
+    for (i = 0; i < k; i++) {
+        yty_row = MATRIX_ROW(solver->HtH, i);
+        for (j = 0; j < k; j++) {
+            objective += yty_row[j] * yty_row[j];
+        }
+    }
+    distance = 0.0;
+    norm_squared = 0.0;
+    for (i = 0; i < n; i++) {
+        h_row = MATRIX_ROW(H, i);
+        y_row = MATRIX_ROW(solver->Y, i);
+        wy_row = MATRIX_ROW(solver->WH, i);
+        yyty_row = MATRIX_ROW(solver->HHtH, i);
+        next_row = MATRIX_ROW(solver->next_H, i);
+        for (j = 0; j < k; j++) {
+            objective -= 2 * y_row[j] * wy_row[j];
+            next_row[j] = y_row[j] * (0.5 + 0.5 * (wy_row[j] / yyty_row[j]));
+            diff = next_row[j] - h_row[j];
+            distance += diff * diff;
+            norm_squared += next_row[j] * next_row[j];
+        }
+    }
+    solver->momentum_steps = solver->momentum_steps > 1 && objective > solver->momentum_objective
+        ? 1 : solver->momentum_steps + 1;
+    solver->momentum_objective = objective;
+    solver->norm_squared = norm_squared;
+    swap = solver->G;
+    solver->G = solver->H;
+    solver->H = solver->next_H;
+    solver->next_H = swap;
+    return distance;
+}
+
+/* Helper function to compute a real cube root; cbrt is not part of C89 */
+static double cube_root(double x) {
+    return x < 0 ? -pow(-x, 1.0 / 3) : pow(x, 1.0 / 3);
+}
+
+/* Helper function to find the x >= 0 minimizing x^4 / 4 + p x^2 / 2 + q x: 0 or one of the
+ * nonnegative real roots of its derivative x^3 + p x + q */
+static double quartic_minimizer(double p, double q) {
+    int m, count;
+    double discriminant, root, radius, angle, x, value, best, best_value, roots[3];
+    discriminant = q * q / 4 + p * p * p / 27;
+    if (discriminant >= 0) {
+        /* A single real root, by Cardano's formula and one Newton step against cancellation */
+        root = sqrt(discriminant);
+        x = cube_root(-q / 2 + root) + cube_root(-q / 2 - root);
+        if (3 * x * x + p > 0) {
+            x -= (x * x * x + p * x + q) / (3 * x * x + p);
+        }
+        roots[0] = x;
+        count = 1;
+    } else {
+        /* Three real roots (p < 0), by the trigonometric method */
+        radius = 2 * sqrt(-p / 3);
+        angle = 3 * q / (p * radius);
+        angle = acos(angle > 1 ? 1 : (angle < -1 ? -1 : angle)) / 3;
+        for (m = 0; m < 3; m++) {
+            roots[m] = radius * cos(angle - 2 * acos(-1.0) * m / 3);
+        }
+        count = 3;
+    }
+    best = 0.0;
+    best_value = 0.0;
+    for (m = 0; m < count; m++) {
+        x = roots[m];
+        value = x * x * (x * x / 4 + p / 2) + q * x;
+        if (x > 0 && value < best_value) {
+            best = x;
+            best_value = value;
+        }
+    }
+    return best;
+}
+
+/* Helper function to get rows [i0, i0 + rows) of W for the coordinate descent rule: dense rows are
+ * read in place and streamed rows are recomputed into w_rows. For a sparse W *block is NULL. */
+static int similarity_rows(SymnmfSolver *solver, int i0, int rows, double **block, size_t *ld) {
+    int n = solver->H->rows;
+    *block = NULL;
+    *ld = 0;
+    if (solver->streaming_W != NULL) {
+        if (!streaming_block(solver->streaming_W, i0, rows, 0, n, solver->w_rows, (size_t)n)) {
+            return 0;
+        }
+        *block = solver->w_rows;
+        *ld = (size_t)n;
+    } else if (solver->sparse_W == NULL) {
+        *block = MATRIX_ROW(solver->W, i0);
+        *ld = (size_t)solver->W->stride;
+    }
+    return 1;
+}
+
+/* Helper function to add the column i of a sparse W times the change of row i of H to W * H,
+ * returning W_ii */
+static double update_sparse_product(SymnmfSolver *solver, int i, const double *change) {
+    int c, k = solver->H->cols;
+    long t;
+    double w, diagonal = 0.0, *wh_row;
+    SparseMatrix *sparse = solver->sparse_W;
+    for (t = sparse->row_offsets[i]; t < sparse->row_offsets[i + 1]; t++) {
+        w = sparse->values[t];
+        diagonal = sparse->col_indices[t] == i ? w : diagonal;
+        if (change != NULL) {
+            wh_row = MATRIX_ROW(solver->WH, sparse->col_indices[t]);
+            for (c = 0; c < k; c++) {
+                wh_row[c] += w * change[c];
+            }
+        }
+    }
+    return diagonal;
+}
+
+/* Helper function to add sum_j w_row[j] * change_j over the rows change_j of changes to target */
+static void add_weighted_rows(double *target, int k, const double *w_row, const double *changes,
+                              size_t ld, int count) {
+    int j, c;
+    for (j = 0; j < count; j++) {
+        for (c = 0; c < k; c++) {
+            target[c] += w_row[j] * changes[(size_t)j * ld + c];
+        }
+    }
+}
+
+/* Helper function for the coordinate descent rule (Vandaele, Gillis, Lei, Zhong and Dhillon),
+ * the symmetric counterpart of HALS: every entry H_ij in turn, row by row, is set to the exact
+ * minimizer of ||W - H H^T||_F^2 over H_ij >= 0, a quartic in H_ij. H^T H is updated after every
+ * entry. W * H is carried over from the previous update and brought up to date with the changes
+ * of every COORDINATE_BLOCK rows by two gemm calls, the rows of the block itself being corrected
+ * one at a time, so each entry sees all the changes before it. For a sparse W the stored entries
+ * of a row are applied as soon as the row is done. H^T H is recomputed every update to keep
+ * rounding in check. Apart from the gemm calls the sweep is serial. */
+static double coordinate_descent_step(SymnmfSolver *solver) {
+    int n, k, i0, rows, i, j, c;
+    double w_ii, others, cross, p, q, value, diff, distance, norm_squared;
+    double *w_block, *w_row, *h_row, *next_row, *wh_row, *hth_row, *changes;
+    size_t ldw, ldh, ldwh;
+    Matrix *H = solver->H, *HtH = solver->HtH;
+    n = H->rows;
+    k = H->cols;
+    ldh = (size_t)H->stride;
+    ldwh = (size_t)solver->WH->stride;
+    syrk(n, k, H->data, ldh, HtH->data, (size_t)HtH->stride);
+    distance = 0.0;
+    norm_squared = 0.0;
+    for (i0 = 0; i0 < n; i0 += COORDINATE_BLOCK) {
+        rows = n - i0 < COORDINATE_BLOCK ? n - i0 : COORDINATE_BLOCK;
+        if (!similarity_rows(solver, i0, rows, &w_block, &ldw)) {
+            return -1.0;
+        }
+        /* The old rows of the block are not needed once updated, and hold their change instead */
+        changes = MATRIX_ROW(H, i0);
+        for (i = i0; i < i0 + rows; i++) {
+            h_row = MATRIX_ROW(H, i);
+            next_row = MATRIX_ROW(solver->next_H, i);
+            wh_row = MATRIX_ROW(solver->WH, i);
+            memcpy(next_row, h_row, (size_t)k * sizeof(double));
+            if (w_block != NULL) {
+                w_row = w_block + (size_t)(i - i0) * ldw;
+                add_weighted_rows(wh_row, k, w_row + i0, changes, ldh, i - i0);
+                w_ii = w_row[i];
+            } else {
+                w_ii = update_sparse_product(solver, i, NULL);
+            }
+            for (j = 0; j < k; j++) {
+                /* With x = H_ij the objective is x^4 + 2 p x^2 + 4 q x plus terms free of x */
+                hth_row = MATRIX_ROW(HtH, j);
+                others = 0.0;
+                cross = 0.0;
+                for (c = 0; c < k; c++) {
+                    if (c != j) {
+                        others += next_row[c] * next_row[c];
+                        cross += next_row[c] * hth_row[c];
+                    }
+                }
+                p = hth_row[j] - next_row[j] * next_row[j] + others - w_ii;
+                q = cross - next_row[j] * others - (wh_row[j] - w_ii * next_row[j]);
+                value = quartic_minimizer(p, q);
+                diff = value - next_row[j];
+                if (diff != 0) {
+                    for (c = 0; c < k; c++) {
+                        if (c != j) {
+                            hth_row[c] += diff * next_row[c];
+                            MATRIX_ROW(HtH, c)[j] += diff * next_row[c];
+                        }
+                    }
+                    hth_row[j] += (value + next_row[j]) * diff;
+                    next_row[j] = value;
+                }
+            }
+            for (c = 0; c < k; c++) {
+                h_row[c] = next_row[c] - h_row[c];
+                distance += h_row[c] * h_row[c];
+                norm_squared += next_row[c] * next_row[c];
+            }
+            if (w_block == NULL) {
+                update_sparse_product(solver, i, h_row);
+            }
+        }
+        if (w_block == NULL) {
+            continue;
+        }
+        /* Rows of the block: the changes of the rows from their own on; other rows: all of them */
+        for (i = i0; i < i0 + rows; i++) {
+            add_weighted_rows(MATRIX_ROW(solver->WH, i), k, w_block + (size_t)(i - i0) * ldw + i,
+                              MATRIX_ROW(H, i), ldh, i0 + rows - i);
+        }
+        if (!gemm(i0, k, rows, w_block, ldw, 1, changes, ldh, solver->WH->data, ldwh, 1, solver->workspace)
+            || !gemm(n - i0 - rows, k, rows, w_block + i0 + rows, ldw, 1, changes, ldh,
+                     MATRIX_ROW(solver->WH, i0 + rows), ldwh, 1, solver->workspace)) {
+            return -1.0;
+        }
+    }
+    solver->norm_squared = norm_squared;
+    swap_iterates(solver);
+    return distance;
+}
+
+/* Helper function to solve Q_FF x_F = b_F for the passive entries F of x (passive[j] != 0) and set
+ * the others to 0. Q is k x k, symmetric positive definite. The system solved is Q with the rows
+ * and columns outside F replaced by those of the identity, by a Cholesky factorization into
+ * factor (k x k). */
+static void solve_passive_set(const double *Q, size_t ldq, int k, const double *b, const double *passive,
+                              double *x, double *factor) {
+    int i, j, l;
+    double value;
+    for (i = 0; i < k; i++) {
+        for (j = 0; j <= i; j++) {
+            if (passive[i] != 0 && passive[j] != 0) {
+                value = Q[(size_t)i * ldq + j];
+            } else {
+                value = i == j ? 1.0 : 0.0;
+            }
+            for (l = 0; l < j; l++) {
+                value -= factor[(size_t)i * k + l] * factor[(size_t)j * k + l];
+            }
+            factor[(size_t)i * k + j] = i == j ? sqrt(value) : value / factor[(size_t)j * k + j];
+        }
+    }
+    for (i = 0; i < k; i++) {
+        value = passive[i] != 0 ? b[i] : 0.0;
+        for (l = 0; l < i; l++) {
+            value -= factor[(size_t)i * k + l] * x[l];
+        }
+        x[i] = value / factor[(size_t)i * k + i];
+    }
+    for (i = k - 1; i >= 0; i--) {
+        value = x[i];
+        for (l = i + 1; l < k; l++) {
+            value -= factor[(size_t)l * k + i] * x[l];
+        }
+        x[i] = value / factor[(size_t)i * k + i];
+    }
+}
+
+/* Helper function to solve min x^T Q x / 2 - b . x over x >= 0 by block principal pivoting
+ * (Kim and Park), starting from the support of x. Entries of x that break x_F >= 0 and of the
+ * gradient y = Q x - b that break y_G >= 0 swap sets all at once while their number drops, or for
+ * ANLS_BACKUP more exchanges when it does not, and then one at a time, the largest index first;
+ * this terminates. scratch holds ANLS_SCRATCH(k) doubles. */
+static void nnls_row(const double *Q, size_t ldq, int k, const double *b, double *x, double *scratch) {
+    int j, l, pivots, infeasible, best, backup, largest;
+    double *factor = scratch, *y = scratch + (size_t)k * k, *passive = y + k, *next = passive + k;
+    for (j = 0; j < k; j++) {
+        passive[j] = x[j] > 0 ? 1.0 : 0.0;
+    }
+    best = k + 1;
+    backup = ANLS_BACKUP;
+    for (pivots = 0; pivots < ANLS_MAX_PIVOTS(k); pivots++) {
+        solve_passive_set(Q, ldq, k, b, passive, next, factor);
+        infeasible = 0;
+        largest = -1;
+        for (j = 0; j < k; j++) {
+            y[j] = 0.0;
+            if (passive[j] == 0) {
+                y[j] = -b[j];
+                for (l = 0; l < k; l++) {
+                    y[j] += Q[(size_t)j * ldq + l] * next[l];
+                }
+            }
+            if ((passive[j] != 0 && next[j] < 0) || (passive[j] == 0 && y[j] < 0)) {
+                infeasible++;
+                largest = j;
+            }
+        }
+        if (infeasible == 0) {
+            break;
+        }
+        if (infeasible < best) {
+            best = infeasible;
+            backup = ANLS_BACKUP;
+        } else if (backup > 0) {
+            backup--;
+        } else {
+            passive[largest] = passive[largest] != 0 ? 0.0 : 1.0;
+            continue;
+        }
+        for (j = 0; j < k; j++) {
+            if ((passive[j] != 0 && next[j] < 0) || (passive[j] == 0 && y[j] < 0)) {
+                passive[j] = passive[j] != 0 ? 0.0 : 1.0;
+            }
+        }
+    }
+    for (j = 0; j < k; j++) {
+        x[j] = next[j] > 0 ? next[j] : 0.0;
+    }
+}
+
+/* Helper function to solve the rows of min ||W - X F^T||_F^2 + alpha ||X - F||_F^2 over X >= 0 for a
+ * fixed F: row i minimizes x^T (F^T F + alpha I) x / 2 - (WF_i + alpha F_i) . x. WF = W * F is
+ * given and FtF receives F^T F + alpha I. Every row starts from the support of its current value. */
+static void penalized_nnls(SymnmfSolver *solver, Matrix *X, Matrix *F, Matrix *WF, Matrix *FtF) {
+    int n = X->rows, k = X->cols, i, j;
+    double *scratch, *b, *f_row, *wf_row;
+    syrk(n, k, F->data, (size_t)F->stride, FtF->data, (size_t)FtF->stride);
+    for (j = 0; j < k; j++) {
+        MATRIX_ROW(FtF, j)[j] += solver->alpha;
+    }
+    #pragma omp parallel num_threads(solver->threads) private(i, j, scratch, b, f_row, wf_row)
+    {
+        scratch = thread_workspace(solver);
+        /* The right-hand side follows the scratch of nnls_row */
+        b = scratch + ANLS_SCRATCH(k);
+        #pragma omp for schedule(static)
+        for (i = 0; i < n; i++) {
+            f_row = MATRIX_ROW(F, i);
+            wf_row = MATRIX_ROW(WF, i);
+            for (j = 0; j < k; j++) {
+                b[j] = wf_row[j] + solver->alpha * f_row[j];
+            }
+            nnls_row(FtF->data, (size_t)FtF->stride, k, b, MATRIX_ROW(X, i), scratch);
+        }
+    }
+}
+
+/* Helper function for the ANLS rule (Kuang, Ding and Park) on the penalized problem
+ * min ||W - G H^T||_F^2 + alpha ||G - H||_F^2 over G, H >= 0: G is solved exactly for the
+ * current H, then H for the new G, each row by block principal pivoting. alpha stays fixed: a
+ * growing weight shrinks the steps faster than the iterates converge and freezes them, and
+ * with a small one the first exact solves can jump to a poor stationary point. */
+static double anls_step(SymnmfSolver *solver) {
+    int n, k, i, j;
+    double distance, norm_squared, diff, *h_row, *next_row;
+    Matrix *H = solver->H;
+    n = H->rows;
+    k = H->cols;
+    if (!multiply_similarity(solver, H, solver->WH)) {
+        return -1.0;
+    }
+    penalized_nnls(solver, solver->G, H, solver->WH, solver->HtH);
+    if (!multiply_similarity(solver, solver->G, solver->WH)) {
+        return -1.0;
+    }
+    for (i = 0; i < n; i++) {
+        memcpy(MATRIX_ROW(solver->next_H, i), MATRIX_ROW(H, i), (size_t)k * sizeof(double));
+    }
+    penalized_nnls(solver, solver->next_H, solver->G, solver->WH, solver->HtH);
+    distance = 0.0;
+    norm_squared = 0.0;
+    for (i = 0; i < n; i++) {
+        h_row = MATRIX_ROW(H, i);
+        next_row = MATRIX_ROW(solver->next_H, i);
+        for (j = 0; j < k; j++) {
+            diff = next_row[j] - h_row[j];
+            distance += diff * diff;
+            norm_squared += next_row[j] * next_row[j];
+        }
+    }
+    solver->norm_squared = norm_squared;
+    swap_iterates(solver);
+    return distance;
+}
+
+/* Function to perform one SYM-NMF update in place, returning the squared Frobenius distance between iterates */
+double symnmf_step(SymnmfSolver *solver) {
+    switch (solver->method) {
+    case SYMNMF_NESTEROV:
+        return nesterov_step(solver);
+    case SYMNMF_HALS:
+        return coordinate_descent_step(solver);
+    case SYMNMF_ANLS:
+        return anls_step(solver);
+    default:
+        return multiplicative_step(solver);
+    }
+}
+
+/* Helper function to scale H, and W * H with it, by the s > 0 minimizing ||W - s^2 H H^T||_F^2,
+ * s^2 = tr(H^T W H) / ||H^T H||_F^2. From the best multiple of H the first sweep of the coordinate
+ * descent rule does not overshoot, which could leave it in a poor local minimum. */
+static void scale_to_similarity(SymnmfSolver *solver) {
+    int n, k, i, j;
+    double product, gram, scale, *h_row, *wh_row, *hth_row;
+    n = solver->H->rows;
+    k = solver->H->cols;
+    syrk(n, k, solver->H->data, (size_t)solver->H->stride, solver->HtH->data, (size_t)solver->HtH->stride);
+    product = 0.0;
+    for (i = 0; i < n; i++) {
+        h_row = MATRIX_ROW(solver->H, i);
+        wh_row = MATRIX_ROW(solver->WH, i);
+        for (j = 0; j < k; j++) {
+            product += h_row[j] * wh_row[j];
+        }
+    }
+    gram = 0.0;
+    for (i = 0; i < k; i++) {
+        hth_row = MATRIX_ROW(solver->HtH, i);
+        for (j = 0; j < k; j++) {
+            gram += hth_row[j] * hth_row[j];
+        }
+    }
+    if (product <= 0 || gram <= 0) {
+        return;
+    }
+    scale = sqrt(product / gram);
+    for (i = 0; i < n; i++) {
+        h_row = MATRIX_ROW(solver->H, i);
+        wh_row = MATRIX_ROW(solver->WH, i);
+        for (j = 0; j < k; j++) {
+            h_row[j] *= scale;
+            wh_row[j] *= scale;
+        }
+    }
+}
+
+/* Helper function to pick the penalty weight of the ANLS rule: ANLS_PENALTY times the largest
+ * diagonal entry of H^T H, on the scale of the curvature of the row subproblems */
+static double penalty_weight(SymnmfSolver *solver) {
+    int j;
+    double largest = 0.0;
+    Matrix *H = solver->H, *HtH = solver->HtH;
+    syrk(H->rows, H->cols, H->data, (size_t)H->stride, HtH->data, (size_t)HtH->stride);
+    for (j = 0; j < H->cols; j++) {
+        largest = MATRIX_ROW(HtH, j)[j] > largest ? MATRIX_ROW(HtH, j)[j] : largest;
+    }
+    return largest > 0 ? ANLS_PENALTY * largest : ANLS_PENALTY;
+}
+
+/* Function to choose the update rule of a solver, allocating the buffers it needs */
+int set_symnmf_method(SymnmfSolver *solver, SymnmfMethod method) {
+    int i, n, k;
+    n = solver->H->rows;
+    k = solver->H->cols;
+    if ((method == SYMNMF_NESTEROV || method == SYMNMF_ANLS) && solver->G == NULL) {
+        solver->G = initialize_matrix_with_zeros(n, k);
+        if (solver->G == NULL) {
+            return 0;
+        }
+    }
+    if (method == SYMNMF_NESTEROV && solver->Y == NULL) {
+        solver->Y = initialize_matrix_with_zeros(n, k);
+        if (solver->Y == NULL) {
+            return 0;
+        }
+    }
+    if (method == SYMNMF_NESTEROV || method == SYMNMF_ANLS) {
+        /* G starts at H: as the previous iterate of the momentum rule or the first ANLS factor */
+        for (i = 0; i < n; i++) {
+            memcpy(MATRIX_ROW(solver->G, i), MATRIX_ROW(solver->H, i), (size_t)k * sizeof(double));
+        }
+    }
+    if (method == SYMNMF_HALS && solver->streaming_W != NULL && solver->w_rows == NULL) {
+        solver->w_rows = allocate_matrix_data(COORDINATE_BLOCK, n);
+        if (solver->w_rows == NULL) {
+            return 0;
+        }
+    }
+    if (method == SYMNMF_HALS || method == SYMNMF_ANLS) {
+        /* Both start from the best multiple of H; the coordinate descent rule also keeps
+         * W * H up to date from here on */
+        if (!multiply_similarity(solver, solver->H, solver->WH)) {
+            return 0;
+        }
+        scale_to_similarity(solver);
+    }
+    if (method == SYMNMF_ANLS) {
+        for (i = 0; i < n; i++) {
+            memcpy(MATRIX_ROW(solver->G, i), MATRIX_ROW(solver->H, i), (size_t)k * sizeof(double));
+        }
+        solver->alpha = penalty_weight(solver);
+    }
+    solver->momentum_steps = 1;
+    solver->momentum_objective = 0.0;
+    solver->method = method;
+    return 1;
+}
+
+/* Function to look up an update rule by name */
+int symnmf_method_from_name(const char *name, SymnmfMethod *method) {
+    const char *names[4] = {"mu", "nesterov", "hals", "anls"};
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *method = (SymnmfMethod)i;
+            return 1;
+        }
     }
-    free_matrix(matrix); 
     return 0;
-}
\ No newline at end of file
+}
+
+/* Function to take the current iterate out of a solver; the caller becomes its owner. The two
+ * factors of the ANLS rule are first projected onto G = H, that is replaced by (G + H) / 2. */
+Matrix* detach_symnmf_solution(SymnmfSolver *solver) {
+    int i, j;
+    double *h_row, *g_row;
+    Matrix *H = solver->H;
+    if (solver->method == SYMNMF_ANLS && H != NULL) {
+        for (i = 0; i < H->rows; i++) {
+            h_row = MATRIX_ROW(H, i);
+            g_row = MATRIX_ROW(solver->G, i);
+            for (j = 0; j < H->cols; j++) {
+                h_row[j] = 0.5 * (h_row[j] + g_row[j]);
+            }
+        }
+    }
+    solver->H = NULL;
+    return H;
+}
+
+/* Function to update matrix H in the SYM-NMF algorithm */
+Matrix* update(Matrix* H, Matrix* W) {
+    Matrix *next_h;
+    SymnmfSolver *solver = create_symnmf_solver(H, W);
+    if (solver == NULL) {
+        return NULL;
+    }
+    next_h = symnmf_step(solver) < 0 ? NULL : detach_symnmf_solution(solver);
+    free_symnmf_solver(solver);
+    return next_h;
+}
+
+/* Helper function to read a monotonic wall clock in seconds */
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Function to fill in the default stopping rule */
+void default_symnmf_options(SymnmfOptions *options) {
+    options->method = SYMNMF_MU;
+    options->max_iter = SYMNMF_MAX_ITER;
+    options->eps = SYMNMF_EPS;
+    options->relative_tolerance = 0.0;
+    options->time_budget = 0.0;
+    options->callback = NULL;
+    options->callback_data = NULL;
+}
+
+/* Function to iterate a solver until the stopping rule is met, then free it and return the final H */
+Matrix* run_symnmf_solver(SymnmfSolver *solver, const SymnmfOptions *options) {
+    int iter;
+    double distance, relative_change, start, elapsed;
+    Matrix *result;
+    iter = 0;
+    if (solver == NULL) {
+        return NULL;
+    }
+    if (!set_symnmf_method(solver, options->method)) {
+        free_symnmf_solver(solver);
+        return NULL;
+    }
+    start = wall_time();
+    while (iter < options->max_iter) {
+        distance = symnmf_step(solver);
+        if (distance < 0) {
+            free_symnmf_solver(solver);
+            return NULL;
+        }
+        iter++;
+        relative_change = solver->norm_squared > 0 ? sqrt(distance / solver->norm_squared) : 0.0;
+        elapsed = wall_time() - start;
+        if (options->callback != NULL
+            && options->callback(iter, distance, relative_change, elapsed, options->callback_data)) {
+            break;
+        }
+        if (distance < options->eps || relative_change < options->relative_tolerance
+            || (options->time_budget > 0 && elapsed >= options->time_budget)) {
+            break;
+        }
+    }
+    result = detach_symnmf_solution(solver);
+    free_symnmf_solver(solver);
+    return result;
+}
+
+/* Function to perform the SYM-NMF algorithm */
+Matrix* symnmf(Matrix *H, Matrix *W) {
+    SymnmfOptions options;
+    default_symnmf_options(&options);
+    return run_symnmf_solver(create_symnmf_solver(H, W), &options);
+}
+
+/* Function to perform the SYM-NMF algorithm on a sparse similarity graph */
+Matrix* sparse_symnmf(Matrix *H, SparseMatrix *W) {
+    SymnmfOptions options;
+    default_symnmf_options(&options);
+    return run_symnmf_solver(create_sparse_symnmf_solver(H, W), &options);
+}
+
+/* Function to perform the SYM-NMF algorithm on a streamed similarity matrix */
+Matrix* streaming_symnmf(Matrix *H, StreamingSimilarity *W) {
+    SymnmfOptions options;
+    default_symnmf_options(&options);
+    return run_symnmf_solver(create_streaming_symnmf_solver(H, W), &options);
+}
+
+/* Function to compute the mean of all entries of a matrix */
+double matrix_mean(Matrix *matrix) {
+    int i, j;
+    double sum, row_sum, *row;
+    sum = 0.0;
+    for (i = 0; i < matrix->rows; i++) {
+        row = MATRIX_ROW(matrix, i);
+        row_sum = 0.0;
+        for (j = 0; j < matrix->cols; j++) {
+            row_sum += row[j];
+        }
+        sum += row_sum;
+    }
+    return sum / ((double)matrix->rows * matrix->cols);
+}
+
+/* Function to copy a matrix with every entry multiplied by scale */
+Matrix* scaled_matrix(Matrix *matrix, double scale) {
+    int i, j;
+    double *row, *scaled_row;
+    Matrix *scaled = initialize_matrix_with_zeros(matrix->rows, matrix->cols);
+    if (scaled == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < matrix->rows; i++) {
+        row = MATRIX_ROW(matrix, i);
+        scaled_row = MATRIX_ROW(scaled, i);
+        for (j = 0; j < matrix->cols; j++) {
+            scaled_row[j] = row[j] * scale;
+        }
+    }
+    return scaled;
+}
+
+/* Function to draw a matrix of uniform [0, 1) values, row by row, from a seeded generator */
+Matrix* random_uniform_matrix(int rows, int cols, unsigned long seed) {
+    int i, j;
+    double *row;
+    RandomState state;
+    Matrix *matrix = initialize_matrix_with_zeros(rows, cols);
+    if (matrix == NULL) {
+        return NULL;
+    }
+    seed_random(&state, seed);
+    for (i = 0; i < rows; i++) {
+        row = MATRIX_ROW(matrix, i);
+        for (j = 0; j < cols; j++) {
+            row[j] = random_uniform(&state);
+        }
+    }
+    return matrix;
+}
+
+/* Function to run the whole dense SYM-NMF from the points: norm, mean, initial H and iterations */
+Matrix* fit_symnmf(Matrix *X, Matrix *U, const SymnmfOptions *options) {
+    Matrix *W, *H, *result;
+    if (X == NULL || U == NULL || U->rows != X->rows) {
+        return NULL;
+    }
+    W = norm(X);
+    if (W == NULL) {
+        return NULL;
+    }
+    H = scaled_matrix(U, 2 * sqrt(matrix_mean(W) / U->cols));
+    result = H == NULL ? NULL : run_symnmf_solver(create_symnmf_solver(H, W), options);
+    free_matrix(H);
+    free_matrix(W);
+    return result;
+}
+
+/* Function to label every row of H with the column of its largest entry */
+void hard_cluster_labels(Matrix *H, int *labels) {
+    int i, j, best;
+    double *row;
+    for (i = 0; i < H->rows; i++) {
+        row = MATRIX_ROW(H, i);
+        best = 0;
+        for (j = 1; j < H->cols; j++) {
+            if (row[j] > row[best]) {
+                best = j;
+            }
+        }
+        labels[i] = best;
+    }
+}
+
+/* Function to print a matrix with specific formatting */
+void print_matrix(Matrix *matrix) {
+    write_matrix_text(matrix, stdout);
+}
+
+/* Function to calculate the Frobenius distance between two matrices */
+double frobidean_distance(Matrix* mat1, Matrix* mat2) {
+    double d = 0.0, diff, *row1, *row2;
+    int i, j;
+    int rows = mat1->rows;
+    int cols = mat1->cols;
+    for (i = 0; i < rows; i++) {
+        row1 = MATRIX_ROW(mat1, i);
+        row2 = MATRIX_ROW(mat2, i);
+        for (j = 0; j < cols; j++) {
+            diff = row1[j] - row2[j];
+            d += diff * diff;
+        }
+    }
+    return sqrt(d);
+}
+
+/* Function to transpose a matrix */
+Matrix* transpose(Matrix* matrix) {
+    int rows, cols, i, j;
+    double *row;
+    Matrix* transposed_matrix;
+    if (matrix == NULL) {
+        return NULL;
+    }
+    rows = matrix->rows;
+    cols = matrix->cols;
+    transposed_matrix = initialize_matrix_with_zeros(cols, rows);
+    if (transposed_matrix == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < rows; i++) {
+        row = MATRIX_ROW(matrix, i);
+        for (j = 0; j < cols; j++) {
+            MATRIX_ROW(transposed_matrix, j)[i] = row[j];
+        }
+    }
+    return transposed_matrix;
+}
+
+/* Function to set the number of threads the parallel kernels use; non-positive values keep the default */
+void set_num_threads(int threads) {
+#ifdef _OPENMP
+    if (threads > 0) {
+        omp_set_num_threads(threads);
+    }
+#else
+    (void)threads;
+#endif
+}
+
+/* The command-line program; the benchmarks link the library part of this file without it */
+#ifndef SYMNMF_NO_MAIN
+
+/* Helper function to log one SYM-NMF update to stderr */
+static int log_iteration(int iteration, double residual, double relative_change, double elapsed, void *data) {
+    (void)data;
+    fprintf(stderr, "iteration %d: residual %.6e, relative change %.6e, %.6f s\n",
+            iteration, residual, relative_change, elapsed);
+    return 0;
+}
+
+/* Helper function to parse the command line:
+ * [--threads N] [--knn K] [--radius R] [--streaming] [--output FILE] [--no-verify]
+ * [--k K] [--seed S] [--max-iter N] [--eps E] [--tol T] [--time-budget SECONDS] [--log]
+ * [--method mu|nesterov|hals|anls] [--algorithm lloyd|hamerly|elkan|auto] [--batch-size B]
+ * [--k-min K] [--restarts R] [--sample S] goal file_name
+ * where goal is sym, ddg, norm, symnmf, kmeans or select */
+static int parse_arguments(int argc, char *argv[], CliOptions *options) {
+    int i, positional = 0;
+    options->goal = NULL;
+    options->file_name = NULL;
+    options->threads = 0;
+    options->neighbors = 0;
+    options->radius = 0.0;
+    options->streaming = 0;
+    options->output = NULL;
+    options->k = 0;
+    options->seed = 0;
+    default_symnmf_options(&options->symnmf);
+    options->kmeans_algorithm = KMEANS_AUTO;
+    options->batch_size = 0;
+    options->k_min = 2;
+    options->restarts = 1;
+    options->silhouette_sample = 0;
+    options->verify = 1;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->threads = atoi(argv[++i]);
+            if (options->threads <= 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--knn") == 0 && i + 1 < argc) {
+            options->neighbors = atoi(argv[++i]);
+            if (options->neighbors <= 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+            options->radius = atof(argv[++i]);
+            if (!(options->radius > 0)) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options->output = argv[++i];
+        } else if (strcmp(argv[i], "--streaming") == 0) {
+            options->streaming = 1;
+        } else if (strcmp(argv[i], "--no-verify") == 0) {
+            options->verify = 0;
+        } else if (strcmp(argv[i], "--k") == 0 && i + 1 < argc) {
+            options->k = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            options->symnmf.max_iter = atoi(argv[++i]);
+            if (options->symnmf.max_iter < 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--eps") == 0 && i + 1 < argc) {
+            options->symnmf.eps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tol") == 0 && i + 1 < argc) {
+            options->symnmf.relative_tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--time-budget") == 0 && i + 1 < argc) {
+            options->symnmf.time_budget = atof(argv[++i]);
+            if (options->symnmf.time_budget < 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--method") == 0 && i + 1 < argc) {
+            if (!symnmf_method_from_name(argv[++i], &options->symnmf.method)) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc) {
+            if (!kmeans_algorithm_from_name(argv[++i], &options->kmeans_algorithm)) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc) {
+            options->batch_size = atoi(argv[++i]);
+            if (options->batch_size <= 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--k-min") == 0 && i + 1 < argc) {
+            options->k_min = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--restarts") == 0 && i + 1 < argc) {
+            options->restarts = atoi(argv[++i]);
+            if (options->restarts <= 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            options->silhouette_sample = atoi(argv[++i]);
+            if (options->silhouette_sample < 0) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--log") == 0) {
+            options->symnmf.callback = log_iteration;
+        } else if (positional == 0) {
+            options->goal = argv[i];
+            positional++;
+        } else if (positional == 1) {
+            options->file_name = argv[i];
+            positional++;
+        } else {
+            return 0;
+        }
+    }
+    return positional == 2;
+}
+
+/* Helper function to run the symnmf goal from a seeded initial H, on the dense, kNN or streamed W */
+static Matrix* run_symnmf_goal(Matrix *points, CliOptions *options) {
+    Matrix *U, *H, *result;
+    SparseMatrix *graph;
+    StreamingSimilarity *streamed;
+    double mean;
+    int k = options->k;
+    if (k < 1 || k >= points->rows) {
+        return NULL;
+    }
+    U = random_uniform_matrix(points->rows, k, options->seed);
+    if (U == NULL) {
+        return NULL;
+    }
+    result = NULL;
+    if (options->neighbors > 0 || options->radius > 0) {
+        graph = knn_norm(points, options->neighbors, options->radius);
+        H = graph == NULL ? NULL : scaled_matrix(U, 2 * sqrt(sparse_mean(graph) / k));
+        if (H != NULL) {
+            result = run_symnmf_solver(create_sparse_symnmf_solver(H, graph), &options->symnmf);
+        }
+        free_sparse_matrix(graph);
+    } else if (options->streaming) {
+        streamed = create_streaming_similarity(points, 1, NULL);
+        mean = streamed == NULL ? -1.0 : streaming_mean(streamed);
+        H = mean < 0 ? NULL : scaled_matrix(U, 2 * sqrt(mean / k));
+        if (H != NULL) {
+            result = run_symnmf_solver(create_streaming_symnmf_solver(H, streamed), &options->symnmf);
+        }
+        free_streaming_similarity(streamed);
+    } else {
+        H = NULL;
+        result = fit_symnmf(points, U, &options->symnmf);
+    }
+    free_matrix(H);
+    free_matrix(U);
+    return result;
+}
+
+/* Helper function to run the select goal: SYM-NMF for every k from --k-min to --k with --restarts
+ * seeds from --seed on, returning the table of the runs */
+static Matrix* run_select_goal(Matrix *points, CliOptions *options) {
+    int i, k_count, *ks;
+    SelectionOptions selection_options;
+    ModelSelection *selection;
+    Matrix *table;
+    k_count = options->k - options->k_min + 1;
+    if (options->k_min < 1 || k_count < 1) {
+        return NULL;
+    }
+    ks = (int *)malloc((size_t)k_count * sizeof(int));
+    if (ks == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < k_count; i++) {
+        ks[i] = options->k_min + i;
+    }
+    default_selection_options(&selection_options);
+    selection_options.symnmf = options->symnmf;
+    selection_options.restarts = options->restarts;
+    selection_options.seed = options->seed;
+    selection_options.silhouette_sample = options->silhouette_sample;
+    selection = select_symnmf_model(points, ks, k_count, &selection_options);
+    table = selection == NULL ? NULL : model_selection_table(selection);
+    free_model_selection(selection);
+    free(ks);
+    return table;
+}
+
+/* Helper function to run the kmeans goal: k-means from the first k points, with the iteration
+ * limit and epsilon of --max-iter and --eps and the assignment step of --algorithm */
+static Matrix* run_kmeans_goal(Matrix *points, CliOptions *options) {
+    KmeansOptions kmeans_options;
+    default_kmeans_options(&kmeans_options);
+    kmeans_options.algorithm = options->kmeans_algorithm;
+    kmeans_options.max_iter = options->symnmf.max_iter;
+    kmeans_options.eps = options->symnmf.eps;
+    return kmeans(points, options->k, &kmeans_options, NULL);
+}
+
+/* Helper function to run the kmeans goal with --batch-size: mini-batch k-means that reads the
+ * file a batch at a time instead of loading it */
+static int run_minibatch_kmeans_goal(CliOptions *options) {
+    KmeansOptions kmeans_options;
+    MatrixReader *reader;
+    Matrix *centroids;
+    long rows, error_line;
+    int ok;
+    default_kmeans_options(&kmeans_options);
+    kmeans_options.max_iter = options->symnmf.max_iter;
+    kmeans_options.eps = options->symnmf.eps;
+    kmeans_options.batch_size = options->batch_size;
+    reader = open_matrix_reader(options->file_name, &error_line);
+    centroids = minibatch_kmeans(reader, options->k, &kmeans_options, &rows, &error_line);
+    close_matrix_reader(reader);
+    if (centroids == NULL) {
+        if (error_line > 0) {
+            fprintf(stderr, "%s:%ld: malformed row\n", options->file_name, error_line);
+        }
+        return 0;
+    }
+    ok = options->output != NULL ? write_matrix_binary(centroids, options->output) : write_matrix_text(centroids, stdout);
+    free_matrix(centroids);
+    return ok;
+}
+
+/* Main function to execute the program based on command-line arguments */
+int main(int argc, char *argv[]) {
+    char *goal, *file_name;
+    long error_line;
+    CliOptions options;
+    Matrix *matrix, *result;
+    Vector *diagonal;
+    SparseMatrix *graph;
+    StreamingSimilarity *streamed;
+    int sparse;
+    if (!parse_arguments(argc, argv, &options)) {
+        fprintf(stderr, "An Error Has Occurred\n");
+        return 1;
+    }
+    goal = options.goal;
+    file_name = options.file_name;
+    set_num_threads(options.threads);
+    if (options.batch_size > 0 && strcmp(goal, "kmeans") == 0) {
+        if (!run_minibatch_kmeans_goal(&options)) {
+            fprintf(stderr, "An Error Has Occurred\n");
+            return 1;
+        }
+        return 0;
+    }
+    matrix = read_matrix_file(file_name, options.verify, &error_line);
+    if (matrix == NULL) {
+        if (error_line > 0) {
+            fprintf(stderr, "%s:%ld: malformed row\n", file_name, error_line);
+        }
+        fprintf(stderr, "An Error Has Occurred\n");
+        return 1;
+    }
+    result = NULL;
+    sparse = options.neighbors > 0 || options.radius > 0;
+    if (options.streaming && !sparse && options.output == NULL && (strcmp(goal, "sym") == 0 || strcmp(goal, "norm") == 0)) {
+        /* Print the matrix a few rows at a time instead of storing all n x n entries */
+        streamed = create_streaming_similarity(matrix, strcmp(goal, "norm") == 0, NULL);
+        if (streamed == NULL || !print_streaming_matrix(streamed)) {
+            fprintf(stderr, "An Error Has Occurred\n");
+            free_streaming_similarity(streamed);
+            free_matrix(matrix);
+            return 1;
+        }
+        free_streaming_similarity(streamed);
+    } else if (strcmp(goal, "sym") == 0) {
+        if (sparse) {
+            graph = knn_sym(matrix, options.neighbors, options.radius);
+            result = sparse_to_matrix(graph);
+            free_sparse_matrix(graph);
+        } else {
+            result = sym(matrix);
+        }
+    } else if (strcmp(goal, "ddg") == 0) {
+        diagonal = sparse ? knn_ddg(matrix, options.neighbors, options.radius) : ddg(matrix);
+        result = diagonal_to_matrix(diagonal);
+        free_vector(diagonal);
+    } else if (strcmp(goal, "symnmf") == 0 || strcmp(goal, "kmeans") == 0 || strcmp(goal, "select") == 0) {
+        if (strcmp(goal, "select") == 0) {
+            result = run_select_goal(matrix, &options);
+        } else {
+            result = strcmp(goal, "kmeans") == 0 ? run_kmeans_goal(matrix, &options) : run_symnmf_goal(matrix, &options);
+        }
+        if (result == NULL) {
+            fprintf(stderr, "An Error Has Occurred\n");
+            free_matrix(matrix);
+            return 1;
+        }
+    } else if (strcmp(goal, "norm") == 0) {
+        if (sparse) {
+            graph = knn_norm(matrix, options.neighbors, options.radius);
+            result = sparse_to_matrix(graph);
+            free_sparse_matrix(graph);
+        } else {
+            result = norm(matrix);
+        }
+    } else {
+        fprintf(stderr, "An Error Has Occurred\n");
+        free_matrix(matrix);
+        return 1;
+    }
+    if (result != NULL && options.output != NULL) {
+        /* Write the result as a binary matrix file instead of printing it */
+        if (!write_matrix_binary(result, options.output)) {
+            fprintf(stderr, "An Error Has Occurred\n");
+            free_matrix(result);
+            free_matrix(matrix);
+            return 1;
+        }
+        free_matrix(result);
+    } else if (result != NULL) {
+        print_matrix(result);
+        free_matrix(result);
+    }
+    free_matrix(matrix); 
+    return 0;
+}
+
+#endif
\ No newline at end of file
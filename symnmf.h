@@ -1,9 +1,113 @@
+#ifndef SYMNMF_H
+#define SYMNMF_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Default stopping rule of the SYM-NMF iterations: at most SYMNMF_MAX_ITER updates, or until
+ * the squared Frobenius distance between consecutive iterates drops below SYMNMF_EPS */
+#define SYMNMF_MAX_ITER 300
+#define SYMNMF_EPS 0.0001
+
+/* Alignment in bytes of every matrix buffer allocated here and of its rows */
+#define MATRIX_ALIGNMENT 64
+
+/* Row-major matrix stored in one contiguous buffer.
+ * Row i starts at data + i * stride; stride >= cols is the padded row length in doubles.
+ * A matrix loaded from a binary matrix file may point into a mapping of that file instead,
+ * in which case mapping is the start of the mapping and free_matrix unmaps it. A matrix may also
+ * borrow a caller's buffer (the Python module wraps NumPy arrays this way); its data and rows are
+ * then only 8-byte aligned and stride may be any value >= cols. The kernels therefore read matrix
+ * rows with unaligned loads and never touch the padding; aligned loads are kept for their own
+ * workspaces. */
 typedef struct Matrix {
     int rows;
     int cols;
-    double **data;
+    int stride;
+    double *data;
+    void *mapping;
+    size_t mapping_length;
 } Matrix;
 
+/* Dense vector of doubles; a diagonal matrix is represented by the vector of its diagonal */
+typedef struct Vector {
+    int length;
+    double *data;
+} Vector;
+
+/* Points prepared for the similarity kernels */
+typedef struct SimilarityPoints {
+    Matrix *points;         /* the input points, row-major, borrowed */
+    Matrix *coordinates;    /* coordinate-major copy: row c holds coordinate c of every point */
+    Vector *squared_norms;  /* ||x_i||^2 of every point */
+} SimilarityPoints;
+
+/* Points with at least this many coordinates get their dot products for the distances from gemm */
+#define SYM_GEMM_MIN_DIM 32
+
+/* Returns a pointer to the first element of row i of a matrix */
+#define MATRIX_ROW(matrix, i) ((matrix)->data + (size_t)(i) * (size_t)(matrix)->stride)
+
+struct SparseMatrix;
+struct StreamingSimilarity;
+
+/* Update rules of the SYM-NMF iterations. All of them minimize ||W - H H^T||_F^2 over H >= 0.
+ * SYMNMF_MU: the beta = 1/2 multiplicative rule, one W product per update.
+ * SYMNMF_NESTEROV: the same rule at a Nesterov-extrapolated point, with restarts.
+ * SYMNMF_HALS: one sweep of exact coordinate descent over the entries of H, the symmetric
+ *              counterpart of HALS; serial, one pass over the rows of W per update.
+ * SYMNMF_ANLS: alternating nonnegative least squares on ||W - G H^T||_F^2 + alpha ||G - H||_F^2,
+ *              two W products per update; the solution is projected onto G = H. */
+typedef enum SymnmfMethod {
+    SYMNMF_MU,
+    SYMNMF_NESTEROV,
+    SYMNMF_HALS,
+    SYMNMF_ANLS
+} SymnmfMethod;
+
+/* Preallocated state of the SYM-NMF iterations. H and next_H are swapped after every
+ * update, so steady-state iterations perform no heap allocations and no copies. */
+typedef struct SymnmfSolver {
+    Matrix *W;          /* normalized similarity matrix, borrowed from the caller */
+    struct SparseMatrix *sparse_W; /* sparse W used instead of W when not NULL, also borrowed */
+    struct StreamingSimilarity *streaming_W; /* recomputed W used instead of W when not NULL, also borrowed */
+    Matrix *H;          /* current iterate */
+    Matrix *next_H;     /* buffer the next iterate is written into */
+    Matrix *WH;         /* W * H */
+    Matrix *HtH;        /* k x k Gram matrix H^T * H */
+    Matrix *HHtH;       /* H * (H^T * H) */
+    double *workspace;  /* packing buffers for gemm and symm, one slice per thread */
+    size_t thread_workspace; /* doubles in each thread's slice of workspace */
+    int threads;        /* threads the updates run on, fixed when the solver is created */
+    double *block_sums; /* per block of rows of H: partial Gram matrix, distance and norm */
+    double norm_squared; /* squared Frobenius norm of H after the last step */
+    int method;         /* SymnmfMethod applied by symnmf_step */
+    Matrix *G;          /* previous iterate of the momentum rule, or the second ANLS factor */
+    Matrix *Y;          /* extrapolated point of the momentum rule */
+    double *w_rows;     /* rows of a streamed W recomputed by the coordinate descent rule */
+    double alpha;       /* penalty weight of the ANLS rule */
+    double momentum_objective; /* objective at the last extrapolated point */
+    int momentum_steps; /* updates since the momentum was last restarted, from 1 */
+} SymnmfSolver;
+
+/* Called after every SYM-NMF update with the update number (from 1), the squared Frobenius
+ * distance between the iterates, that distance relative to the new iterate
+ * (||H_t+1 - H_t||_F / ||H_t+1||_F) and the seconds spent iterating so far.
+ * Returning non-zero stops the iterations. */
+typedef int (*SymnmfCallback)(int iteration, double residual, double relative_change, double elapsed, void *data);
+
+/* Update rule, stopping rule and telemetry of the SYM-NMF iterations. The iterations stop at the first
+ * criterion met; a zero relative_tolerance or time_budget disables that criterion. */
+typedef struct SymnmfOptions {
+    SymnmfMethod method;        /* update rule */
+    int max_iter;               /* most updates made */
+    double eps;                 /* stop once the squared distance between iterates is below eps */
+    double relative_tolerance;  /* stop once the relative change is below this */
+    double time_budget;         /* stop once this many seconds were spent iterating */
+    SymnmfCallback callback;    /* called after every update when not NULL */
+    void *callback_data;        /* passed to the callback */
+} SymnmfOptions;
+
 /* Loads a matrix from a file */
 Matrix* load_matrix_from_file(const char *file_name);
 
@@ -13,20 +117,57 @@ void free_matrix(Matrix *matrix);
 /* Initializes a matrix with zeros */
 Matrix* initialize_matrix_with_zeros(int rows, int cols);
 
+/* Initializes a vector with zeros */
+Vector* initialize_vector_with_zeros(int length);
+
+/* Frees the memory allocated for a vector */
+void free_vector(Vector *vector);
+
+/* Expands a diagonal into a dense square matrix (for output only) */
+Matrix* diagonal_to_matrix(Vector *diagonal);
+
 /* Calculates Euclidean distance between two vectors */
 double euclidean_distance(double *vec1, double *vec2, int length);
 
+/* Maps a flat index onto the (row, column) of a tile in a lower triangle of tiles */
+void triangle_tile_coordinates(long index, int *tile_row, int *tile_col);
+
+/* Prepares points for the similarity kernels */
+SimilarityPoints* prepare_similarity_points(Matrix *matrix);
+
+/* Frees prepared points */
+void free_similarity_points(SimilarityPoints *points);
+
+/* Computes the squared distances from point i to the count points starting at point j0 */
+int similarity_distances(SimilarityPoints *points, int i, int j0, int count, double *out, double *workspace);
+
+/* Fills one tile of the similarity matrix and its mirror image above the diagonal */
+int fill_similarity_tile(SimilarityPoints *points, Matrix *similarity_matrix, int tile_row, int tile_col,
+                         double *workspace);
+
 /* Computes the symmetric similarity matrix */
 Matrix* sym(Matrix *matrix);
 
-/* Computes the diagonal degree matrix */
-Matrix* ddg(Matrix *matrix);
+/* Computes the row sums (degrees) of a similarity matrix */
+Vector* compute_degrees(Matrix *sym_matrix);
+
+/* Computes the diagonal of the degree matrix */
+Vector* ddg(Matrix *matrix);
 
 /* Multiplies two matrices */
 Matrix* multiply_matrices(Matrix *matrix1, Matrix *matrix2);
 
-/* Computes the inverse square root of a matrix */
-Matrix* compute_inverse_sqrt(Matrix *matrix);
+/* Multiplies a symmetric matrix by another matrix */
+Matrix* multiply_symmetric(Matrix *symmetric, Matrix *matrix);
+
+/* Computes the Gram matrix M^T * M of a matrix */
+Matrix* gram_matrix(Matrix *matrix);
+
+/* Computes the inverse square root of a diagonal matrix */
+Vector* compute_inverse_sqrt(Vector *diagonal);
+
+/* Scales a similarity matrix in place to D^-1/2 * A * D^-1/2 */
+void normalize_similarity(Matrix *sym_matrix, Vector *inverse_sqrt);
 
 /* Normalizes a matrix */
 Matrix* norm(Matrix *matrix);
@@ -34,9 +175,49 @@ Matrix* norm(Matrix *matrix);
 /* Updates matrix H in the SYM-NMF algorithm */
 Matrix* update(Matrix* H, Matrix* W);
 
+/* Creates a solver for the given initial H and W; H is copied, W is borrowed */
+SymnmfSolver* create_symnmf_solver(Matrix *H, Matrix *W);
+
+/* Frees a solver and all of its workspace */
+void free_symnmf_solver(SymnmfSolver *solver);
+
+/* Performs one update step; returns the squared Frobenius distance between iterates, or -1 on failure */
+double symnmf_step(SymnmfSolver *solver);
+
+/* Takes ownership of the solver's current iterate, projected onto G = H for the ANLS rule */
+Matrix* detach_symnmf_solution(SymnmfSolver *solver);
+
+/* Chooses the update rule of a solver and allocates its buffers; returns 0 on failure */
+int set_symnmf_method(SymnmfSolver *solver, SymnmfMethod method);
+
+/* Looks up an update rule by name ("mu", "nesterov", "hals" or "anls"); returns 0 if unknown */
+int symnmf_method_from_name(const char *name, SymnmfMethod *method);
+
+/* Fills in the default stopping rule: the multiplicative rule, SYMNMF_MAX_ITER, SYMNMF_EPS and no other criterion */
+void default_symnmf_options(SymnmfOptions *options);
+
+/* Iterates a solver until the stopping rule is met, frees it and returns the final H */
+Matrix* run_symnmf_solver(SymnmfSolver *solver, const SymnmfOptions *options);
+
 /* Performs the SYM-NMF algorithm */
 Matrix* symnmf(Matrix *H, Matrix *W);
 
+/* Computes the mean of all entries of a matrix */
+double matrix_mean(Matrix *matrix);
+
+/* Copies a matrix with every entry multiplied by scale */
+Matrix* scaled_matrix(Matrix *matrix, double scale);
+
+/* Draws a rows x cols matrix of uniform [0, 1) values; equal seeds give equal matrices */
+Matrix* random_uniform_matrix(int rows, int cols, unsigned long seed);
+
+/* Runs SYM-NMF on the points X without leaving C: W = norm(X), H starts at
+ * U * 2 * sqrt(mean(W) / k) for an n x k uniform [0, 1) draw U, and iterates under options */
+Matrix* fit_symnmf(Matrix *X, Matrix *U, const SymnmfOptions *options);
+
+/* Writes the column of the largest entry of every row of H (the first one on ties) to labels */
+void hard_cluster_labels(Matrix *H, int *labels);
+
 /* Prints a matrix with specific formatting */
 void print_matrix(Matrix *matrix);
 
@@ -46,14 +227,13 @@ double frobidean_distance(Matrix* mat1, Matrix* mat2);
 /* Transposes a matrix */
 Matrix* transpose(Matrix* matrix);
 
-/* Cleanup matrix data */
-void cleanup_matrix_data(double **data, int n);
+/* Computes the padded row length of a matrix with the given number of columns */
+int matrix_stride(int cols);
 
-/* Handles file read errors */
-Matrix* handle_file_read_error(FILE *file, double **data, int n);
+/* Allocates an aligned, zero-filled buffer of rows * stride doubles */
+double* allocate_matrix_data(int rows, int stride);
 
-/* Reads matrix data from file */
-int read_matrix_data(FILE *file, double **data, int n, int d);
+/* Sets the number of threads used by the parallel kernels started from the calling thread */
+void set_num_threads(int threads);
 
-/* Counts rows and columns in the file */
-void count_rows_and_columns(FILE *file, int *n, int *d);
+#endif
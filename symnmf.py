@@ -1,6 +1,4 @@
-import math
 import sys
-import pandas as pd
 import numpy as np
 import random
 import mysymnmf as sf
@@ -10,24 +8,33 @@ np.random.seed(1234)
 
 def sym(matrix):
     """Compute the symmetric matrix."""
-    return sf.sym(matrix)
+    return np.asarray(sf.sym(matrix))
 
 def ddg(matrix):
     """Compute the degree diagonal matrix."""
-    return sf.ddg(matrix)
+    return np.asarray(sf.ddg(matrix))
 
 def norm(matrix):
     """Normalize the input matrix."""
-    return sf.norm(matrix)
+    return np.asarray(sf.norm(matrix))
 
-def symnmf(k, matrix):
-    """Perform symmetric non-negative matrix factorization."""
-    W = norm(matrix)
-    m = np.mean(W)
-    H = np.random.uniform(0, 2 * math.sqrt(m / k), size=(len(matrix), k))
-    H_list = H.tolist()
-    result = sf.symnmf(H_list, W)
-    return result
+def symnmf(k, matrix, neighbors=0, radius=0.0, streaming=False, cache_file=None):
+    """Perform symmetric non-negative matrix factorization.
+
+    With neighbors > 0 or radius > 0 the similarity graph is sparsified to the kNN
+    (or epsilon-radius) graph and W is built and factorized entirely in C.
+    With streaming=True W is never stored: its blocks are recomputed from the points in
+    every iteration, or read back from cache_file when one is given.
+    Otherwise W, its mean and the initial H = U * 2 * sqrt(mean(W) / k) stay in C (sf.fit).
+    Matrices travel to and from C through the buffer protocol, without copies."""
+    if neighbors > 0 or radius > 0:
+        U = np.random.uniform(0, 1, size=(len(matrix), k))
+        return np.asarray(sf.knn_symnmf(U, matrix, neighbors, radius))
+    if streaming:
+        U = np.random.uniform(0, 1, size=(len(matrix), k))
+        return np.asarray(sf.streaming_symnmf(U, matrix, cache_file))
+    U = np.random.uniform(0, 1, size=(len(matrix), k))
+    return np.asarray(sf.fit(matrix, k, init=U))
 
 def main():
     """Main function to execute the script."""
@@ -37,8 +44,7 @@ def main():
         k = int(sys.argv[1])
         goal = sys.argv[2]
         file_name = sys.argv[3]
-        data = pd.read_csv(file_name, header=None)
-        matrix = [x.tolist() for index, x in data.iterrows()]
+        matrix = np.asarray(sf.load_matrix(file_name))
         if k >= len(matrix) or len(matrix) == 0:
             raise ValueError("Invalid value of k or empty matrix")
         if goal == "sym":
@@ -1,5 +1,12 @@
 #include <Python.h>
+#include <math.h>
 #include "symnmf.h"
+#include "sparse.h"
+#include "streaming.h"
+#include "matrixio.h"
+#include "kmeans.h"
+#include "silhouette.h"
+#include "selection.h"
 
 /* Helper function to convert a Python list to a Matrix struct */
 Matrix* python_list_to_matrix(PyObject* list) {
@@ -15,6 +22,10 @@ Matrix* python_list_to_matrix(PyObject* list) {
     }
 
     int cols = PyList_Size(PyList_GetItem(list, 0));
+    if (cols <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Input rows cannot be empty.");
+        return NULL;
+    }
     Matrix* matrix = initialize_matrix_with_zeros(rows, cols);
     if (matrix == NULL) {
         PyErr_NoMemory();
@@ -23,6 +34,7 @@ Matrix* python_list_to_matrix(PyObject* list) {
 
     for (int i = 0; i < rows; i++) {
         PyObject* row = PyList_GetItem(list, i);
+        double* values = MATRIX_ROW(matrix, i);
         if (!PyList_Check(row) || PyList_Size(row) != cols) {
             free_matrix(matrix);
             PyErr_SetString(PyExc_ValueError, "All rows must be lists of the same length.");
@@ -36,139 +48,1158 @@ Matrix* python_list_to_matrix(PyObject* list) {
                 PyErr_SetString(PyExc_TypeError, "All elements must be floats.");
                 return NULL;
             }
-            matrix->data[i][j] = PyFloat_AsDouble(item);
+            values[j] = PyFloat_AsDouble(item);
         }
     }
 
     return matrix;
 }
 
-/* Helper function to convert a Matrix struct to a Python list */
-PyObject* matrix_to_python_list(Matrix* matrix) {
-    PyObject* list = PyList_New(matrix->rows);
-    for (int i = 0; i < matrix->rows; i++) {
-        PyObject* row = PyList_New(matrix->cols);
-        for (int j = 0; j < matrix->cols; j++) {
-            PyList_SetItem(row, j, PyFloat_FromDouble(matrix->data[i][j]));
+/* Thread count chosen with set_num_threads, 0 for the OpenMP default. OpenMP keeps the team
+ * size per calling thread, so every wrapper reads this with the GIL held and applies it to its
+ * own thread once the GIL is released; calls from any Python thread then honour it. */
+static int requested_threads = 0;
+
+/* Python object that owns a Matrix and exports it through the buffer protocol, so results
+ * reach NumPy without copying. Rows are padded to the matrix stride, which the exported
+ * strides describe; consumers that cannot handle strides only get contiguous matrices. */
+typedef struct {
+    PyObject_HEAD
+    Matrix* matrix;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} MatrixBufferObject;
+
+/* Function to export the matrix of a MatrixBufferObject */
+static int matrix_buffer_get(PyObject* exporter, Py_buffer* view, int flags) {
+    MatrixBufferObject* self = (MatrixBufferObject*)exporter;
+    Matrix* matrix = self->matrix;
+    int contiguous = matrix->stride == matrix->cols || matrix->rows <= 1;
+
+    int wants_contiguous = (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS
+        || (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS
+        || (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS;
+    if (!contiguous && ((flags & PyBUF_STRIDES) != PyBUF_STRIDES || wants_contiguous)) {
+        PyErr_SetString(PyExc_BufferError, "Matrix rows are padded; request a strided buffer.");
+        view->obj = NULL;
+        return -1;
+    }
+
+    view->buf = matrix->data;
+    view->obj = exporter;
+    Py_INCREF(exporter);
+    view->len = (Py_ssize_t)matrix->rows * matrix->cols * sizeof(double);
+    view->readonly = 0;
+    view->itemsize = sizeof(double);
+    view->format = (flags & PyBUF_FORMAT) ? "d" : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    if (view->shape == NULL) {
+        view->ndim = 1;
+    }
+    return 0;
+}
+
+/* Function to free the matrix once the last view of it is released */
+static void matrix_buffer_dealloc(PyObject* object) {
+    free_matrix(((MatrixBufferObject*)object)->matrix);
+    Py_TYPE(object)->tp_free(object);
+}
+
+static PyBufferProcs matrix_buffer_procs = {
+    matrix_buffer_get,
+    NULL
+};
+
+static PyTypeObject MatrixBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "mysymnmf.MatrixBuffer",
+    .tp_basicsize = sizeof(MatrixBufferObject),
+    .tp_dealloc = matrix_buffer_dealloc,
+    .tp_as_buffer = &matrix_buffer_procs,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Owner of a matrix computed by mysymnmf, exported through the buffer protocol.",
+};
+
+/* Helper function to hand a Matrix over to Python as a 2-D float64 memoryview.
+ * The memoryview owns the matrix; it is freed on failure. */
+static PyObject* matrix_to_memoryview(Matrix* matrix) {
+    MatrixBufferObject* owner = PyObject_New(MatrixBufferObject, &MatrixBufferType);
+    if (owner == NULL) {
+        free_matrix(matrix);
+        return NULL;
+    }
+    owner->matrix = matrix;
+    owner->shape[0] = matrix->rows;
+    owner->shape[1] = matrix->cols;
+    owner->strides[0] = (Py_ssize_t)matrix->stride * sizeof(double);
+    owner->strides[1] = sizeof(double);
+
+    PyObject* view = PyMemoryView_FromObject((PyObject*)owner);
+    Py_DECREF(owner);
+    return view;
+}
+
+/* Helper function to check that a buffer holds a 2-D float64 matrix with contiguous rows */
+static int is_float64_matrix_buffer(Py_buffer* view) {
+    const char* format = view->format == NULL ? "B" : view->format;
+    if (format[0] == '@' || format[0] == '=' || format[0] == '<') {
+        format++;
+    }
+    if (strcmp(format, "d") != 0 || view->itemsize != sizeof(double) || view->ndim != 2) {
+        return 0;
+    }
+    if (view->shape[1] > 1 && view->strides[1] != sizeof(double)) {
+        return 0;
+    }
+    if (view->shape[0] > 1 && (view->strides[0] < view->shape[1] * (Py_ssize_t)sizeof(double)
+                               || view->strides[0] % sizeof(double) != 0)) {
+        return 0;
+    }
+    return (size_t)view->buf % sizeof(double) == 0;
+}
+
+/* Helper function to get a Matrix from a Python object. Objects supporting the buffer
+ * protocol (NumPy arrays, memoryviews returned by this module) are wrapped without copying
+ * and stay pinned in view until release_matrix; lists of lists are copied. Either way the
+ * matrix stays valid while the GIL is released. The matrix is only read, so read-only
+ * buffers are accepted. A wrapped buffer keeps its own alignment and row stride, which the
+ * kernels allow for (see Matrix in symnmf.h). */
+static Matrix* python_to_matrix(PyObject* object, Py_buffer* view) {
+    view->obj = NULL;
+    if (!PyObject_CheckBuffer(object)) {
+        return python_list_to_matrix(object);
+    }
+    if (PyObject_GetBuffer(object, view, PyBUF_STRIDES | PyBUF_FORMAT) < 0) {
+        return NULL;
+    }
+    if (!is_float64_matrix_buffer(view)) {
+        PyBuffer_Release(view);
+        view->obj = NULL;
+        PyErr_SetString(PyExc_TypeError, "Input must be a 2-D float64 array with contiguous rows.");
+        return NULL;
+    }
+    if (view->shape[0] == 0 || view->shape[1] == 0 || view->shape[0] > INT_MAX || view->shape[1] > INT_MAX) {
+        PyBuffer_Release(view);
+        view->obj = NULL;
+        PyErr_SetString(PyExc_ValueError, "Input matrix cannot be empty.");
+        return NULL;
+    }
+
+    Matrix* matrix = (Matrix*)malloc(sizeof(Matrix));
+    if (matrix == NULL) {
+        PyBuffer_Release(view);
+        view->obj = NULL;
+        PyErr_NoMemory();
+        return NULL;
+    }
+    matrix->rows = (int)view->shape[0];
+    matrix->cols = (int)view->shape[1];
+    matrix->stride = view->shape[0] > 1 ? (int)(view->strides[0] / sizeof(double)) : matrix->cols;
+    matrix->data = (double*)view->buf;
+    matrix->mapping = NULL;
+    matrix->mapping_length = 0;
+    return matrix;
+}
+
+/* Helper function to release a Matrix obtained from python_to_matrix */
+static void release_matrix(Matrix* matrix, Py_buffer* view) {
+    if (view->obj == NULL) {
+        free_matrix(matrix);
+        return;
+    }
+    free(matrix);
+    PyBuffer_Release(view);
+}
+
+/* Wrapper function for read_matrix_file, which loads CSV and binary matrix files:
+ * load_matrix(file_name, verify=True). A binary file with the in-memory layout is returned as a
+ * view of its mapping; verify=False skips its checksum, so loading does not read the whole file. */
+static PyObject* py_load_matrix(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"file_name", "verify", NULL};
+    const char* file_name;
+    int verify = 1;
+    long error_line;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|p", keywords, &file_name, &verify)) {
+        return NULL;
+    }
+
+    Matrix* matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    matrix = read_matrix_file(file_name, verify, &error_line);
+    Py_END_ALLOW_THREADS
+    if (matrix == NULL) {
+        if (error_line > 0) {
+            PyErr_Format(PyExc_ValueError, "%s:%ld: malformed row", file_name, error_line);
+        } else {
+            PyErr_Format(PyExc_OSError, "Failed to load %s.", file_name);
         }
-        PyList_SetItem(list, i, row);
+        return NULL;
     }
-    return list;
+
+    return matrix_to_memoryview(matrix);
+}
+
+/* Wrapper function for write_matrix_binary */
+static PyObject* py_save_matrix(PyObject* self, PyObject* args) {
+    PyObject* input_object;
+    const char* file_name;
+    if (!PyArg_ParseTuple(args, "Os", &input_object, &file_name)) {
+        return NULL;
+    }
+
+    Py_buffer input_view;
+    Matrix* matrix = python_to_matrix(input_object, &input_view);
+    if (matrix == NULL) {
+        return NULL;
+    }
+
+    int written;
+    Py_BEGIN_ALLOW_THREADS
+    written = write_matrix_binary(matrix, file_name);
+    Py_END_ALLOW_THREADS
+    release_matrix(matrix, &input_view);
+
+    if (!written) {
+        PyErr_Format(PyExc_OSError, "Failed to write %s.", file_name);
+        return NULL;
+    }
+    Py_RETURN_NONE;
 }
 
 /* Wrapper function for sym */
 static PyObject* py_sym(PyObject* self, PyObject* args) {
-    PyObject* input_list;
-    if (!PyArg_ParseTuple(args, "O", &input_list)) {
+    PyObject* input_object;
+    if (!PyArg_ParseTuple(args, "O", &input_object)) {
         return NULL;
     }
 
-    Matrix* input_matrix = python_list_to_matrix(input_list);
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
     if (input_matrix == NULL) {
-        return NULL;  
+        return NULL;
     }
 
-    Matrix* result_matrix = sym(input_matrix);
-    free_matrix(input_matrix);
+    Matrix* result_matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    result_matrix = sym(input_matrix);
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
 
     if (result_matrix == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to compute the symmetric matrix.");
         return NULL;
     }
 
-    PyObject* result_list = matrix_to_python_list(result_matrix);
-    free_matrix(result_matrix);
-
-    return result_list;
+    return matrix_to_memoryview(result_matrix);
 }
 
 /* Wrapper function for ddg */
 static PyObject* py_ddg(PyObject* self, PyObject* args) {
-    PyObject* input_list;
-    if (!PyArg_ParseTuple(args, "O", &input_list)) {
+    PyObject* input_object;
+    if (!PyArg_ParseTuple(args, "O", &input_object)) {
         return NULL;
     }
 
-    Matrix* input_matrix = python_list_to_matrix(input_list);
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
     if (input_matrix == NULL) {
-        return NULL; 
+        return NULL;
     }
 
-    Matrix* result_matrix = ddg(input_matrix);
-    free_matrix(input_matrix);
+    Matrix* result_matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    Vector* diagonal = ddg(input_matrix);
+    result_matrix = diagonal_to_matrix(diagonal);
+    free_vector(diagonal);
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
 
     if (result_matrix == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to compute the diagonal degree matrix.");
         return NULL;
     }
 
-    PyObject* result_list = matrix_to_python_list(result_matrix);
-    free_matrix(result_matrix);
-
-    return result_list;
+    return matrix_to_memoryview(result_matrix);
 }
 
 /* Wrapper function for norm */
 static PyObject* py_norm(PyObject* self, PyObject* args) {
-    PyObject* input_list;
-    if (!PyArg_ParseTuple(args, "O", &input_list)) {
+    PyObject* input_object;
+    if (!PyArg_ParseTuple(args, "O", &input_object)) {
         return NULL;
     }
 
-    Matrix* input_matrix = python_list_to_matrix(input_list);
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
     if (input_matrix == NULL) {
-        return NULL; 
+        return NULL;
     }
 
-    Matrix* result_matrix = norm(input_matrix);
-    free_matrix(input_matrix);
+    Matrix* result_matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    result_matrix = norm(input_matrix);
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
 
     if (result_matrix == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to compute the normalized similarity matrix.");
         return NULL;
     }
 
-    PyObject* result_list = matrix_to_python_list(result_matrix);
-    free_matrix(result_matrix);
-
-    return result_list;
+    return matrix_to_memoryview(result_matrix);
 }
 
-/* Wrapper function for symnmf */
+/* Wrapper function for symnmf. H is copied by the solver, so both inputs are only read. */
 static PyObject* py_symnmf(PyObject* self, PyObject* args) {
-    PyObject* H_list;
-    PyObject* W_list;
-    if (!PyArg_ParseTuple(args, "OO", &H_list, &W_list)) {
+    PyObject* H_object;
+    PyObject* W_object;
+    if (!PyArg_ParseTuple(args, "OO", &H_object, &W_object)) {
         return NULL;
     }
 
-    Matrix* H_matrix = python_list_to_matrix(H_list);
-    Matrix* W_matrix = python_list_to_matrix(W_list);
-    if (H_matrix == NULL || W_matrix == NULL) {
-        return NULL;  
+    Py_buffer H_view;
+    Py_buffer W_view;
+    Matrix* H_matrix = python_to_matrix(H_object, &H_view);
+    if (H_matrix == NULL) {
+        return NULL;
+    }
+    Matrix* W_matrix = python_to_matrix(W_object, &W_view);
+    if (W_matrix == NULL) {
+        release_matrix(H_matrix, &H_view);
+        return NULL;
     }
 
-    Matrix* result_matrix = symnmf(H_matrix, W_matrix);
-    free_matrix(H_matrix);
-    free_matrix(W_matrix);
+    Matrix* result_matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    result_matrix = symnmf(H_matrix, W_matrix);
+    Py_END_ALLOW_THREADS
+    release_matrix(H_matrix, &H_view);
+    release_matrix(W_matrix, &W_view);
 
     if (result_matrix == NULL) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to compute the symnmf matrix.");
         return NULL;
     }
 
-    PyObject* result_list = matrix_to_python_list(result_matrix);
-    free_matrix(result_matrix);
+    return matrix_to_memoryview(result_matrix);
+}
+
+/* Python callable invoked after every SYM-NMF update */
+typedef struct {
+    PyObject* callable;
+    int failed;     /* set when the callable raised; the exception is left pending */
+} PythonCallback;
+
+/* Helper function to call a Python callback from the iterations, which run without the GIL.
+ * A true return value or an exception stops the iterations. */
+static int call_python_callback(int iteration, double residual, double relative_change, double elapsed, void* data) {
+    PythonCallback* callback = (PythonCallback*)data;
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject* result = PyObject_CallFunction(callback->callable, "iddd", iteration, residual, relative_change, elapsed);
+    int stop = 1;
+    if (result == NULL) {
+        callback->failed = 1;
+    } else {
+        stop = PyObject_IsTrue(result);
+        if (stop < 0) {
+            callback->failed = 1;
+            stop = 1;
+        }
+        Py_DECREF(result);
+    }
+    PyGILState_Release(gil);
+    return stop;
+}
+
+/* Helper function to expose a bytearray of C ints as an int32 memoryview; steals the reference */
+static PyObject* labels_to_memoryview(PyObject* labels_object) {
+    PyObject* bytes_view = PyMemoryView_FromObject(labels_object);
+    Py_DECREF(labels_object);
+    PyObject* labels_view = bytes_view == NULL ? NULL : PyObject_CallMethod(bytes_view, "cast", "s", "i");
+    Py_XDECREF(bytes_view);
+    return labels_view;
+}
+
+/* Wrapper function for fit_symnmf: fit(X, k, seed=0, max_iter=300, eps=1e-4, labels=False,
+ * init=None, tol=0.0, time_budget=0.0, callback=None, method="mu").
+ * W, its mean and the initial H never leave C. H starts from a uniform draw seeded by seed, or
+ * from init (an n x k uniform [0, 1) draw) when given. method picks the update rule ("mu", "nesterov",
+ * "hals" or "anls"); tol and time_budget add the relative
+ * change and wall-time criteria of SymnmfOptions; callback(iteration, residual, relative_change,
+ * seconds) is called after every update and stops the iterations by returning a true value.
+ * Returns H, or (H, labels) with labels. */
+static PyObject* py_fit(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"X", "k", "seed", "max_iter", "eps", "labels", "init", "tol", "time_budget", "callback", "method", NULL};
+    PyObject* X_object;
+    PyObject* init_object = Py_None;
+    PyObject* callback_object = Py_None;
+    int k;
+    unsigned long seed = 0;
+    int want_labels = 0;
+    const char* method_name = "mu";
+    SymnmfOptions options;
+    default_symnmf_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|kidpOddOs", keywords, &X_object, &k, &seed,
+                                     &options.max_iter, &options.eps, &want_labels, &init_object,
+                                     &options.relative_tolerance, &options.time_budget, &callback_object,
+                                     &method_name)) {
+        return NULL;
+    }
+    if (!symnmf_method_from_name(method_name, &options.method)) {
+        PyErr_Format(PyExc_ValueError, "Unknown method %s; use mu, nesterov, hals or anls.", method_name);
+        return NULL;
+    }
+    if (options.max_iter < 0 || options.eps < 0 || options.relative_tolerance < 0 || options.time_budget < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_iter, eps, tol and time_budget cannot be negative.");
+        return NULL;
+    }
+    PythonCallback callback = {callback_object, 0};
+    if (callback_object != Py_None) {
+        if (!PyCallable_Check(callback_object)) {
+            PyErr_SetString(PyExc_TypeError, "callback must be callable.");
+            return NULL;
+        }
+        options.callback = call_python_callback;
+        options.callback_data = &callback;
+    }
+
+    Py_buffer X_view;
+    Py_buffer U_view;
+    U_view.obj = NULL;
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        return NULL;
+    }
+    if (k < 1 || k >= X_matrix->rows) {
+        release_matrix(X_matrix, &X_view);
+        PyErr_SetString(PyExc_ValueError, "k must be between 1 and the number of points - 1.");
+        return NULL;
+    }
+    Matrix* U_matrix = NULL;
+    if (init_object != Py_None) {
+        U_matrix = python_to_matrix(init_object, &U_view);
+        if (U_matrix == NULL || U_matrix->rows != X_matrix->rows || U_matrix->cols != k) {
+            if (U_matrix != NULL) {
+                release_matrix(U_matrix, &U_view);
+                PyErr_SetString(PyExc_ValueError, "init must be an n x k matrix.");
+            }
+            release_matrix(X_matrix, &X_view);
+            return NULL;
+        }
+    }
+    PyObject* labels_object = NULL;
+    int* labels = NULL;
+    if (want_labels) {
+        labels_object = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)X_matrix->rows * sizeof(int));
+        if (labels_object == NULL) {
+            release_matrix(X_matrix, &X_view);
+            if (U_matrix != NULL) {
+                release_matrix(U_matrix, &U_view);
+            }
+            return NULL;
+        }
+        labels = (int*)PyByteArray_AS_STRING(labels_object);
+    }
+
+    Matrix* result_matrix = NULL;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    Matrix* drawn_U = U_matrix == NULL ? random_uniform_matrix(X_matrix->rows, k, seed) : NULL;
+    result_matrix = fit_symnmf(X_matrix, U_matrix != NULL ? U_matrix : drawn_U, &options);
+    if (result_matrix != NULL && labels != NULL) {
+        hard_cluster_labels(result_matrix, labels);
+    }
+    free_matrix(drawn_U);
+    Py_END_ALLOW_THREADS
+    release_matrix(X_matrix, &X_view);
+    if (U_matrix != NULL) {
+        release_matrix(U_matrix, &U_view);
+    }
+
+    if (result_matrix == NULL || callback.failed) {
+        Py_XDECREF(labels_object);
+        free_matrix(result_matrix);
+        if (!callback.failed) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to compute the symnmf matrix.");
+        }
+        return NULL;
+    }
+
+    PyObject* H_view = matrix_to_memoryview(result_matrix);
+    if (labels_object == NULL || H_view == NULL) {
+        Py_XDECREF(labels_object);
+        return H_view;
+    }
+    PyObject* labels_view = labels_to_memoryview(labels_object);
+    if (labels_view == NULL) {
+        Py_DECREF(H_view);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", H_view, labels_view);
+}
 
-    return result_list;
+/* Wrapper function for kmeans: kmeans(X, k, max_iter=300, eps=1e-4, algorithm="auto") with
+ * kmeans.py's first-k initialization and stopping rule. algorithm picks the assignment step
+ * ("lloyd", "hamerly", "elkan" or "auto"), which does not change the result. Returns (centroids, labels). */
+static PyObject* py_kmeans(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"X", "k", "max_iter", "eps", "algorithm", NULL};
+    PyObject* X_object;
+    int k;
+    const char* algorithm_name = "auto";
+    KmeansOptions options;
+    default_kmeans_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|ids", keywords, &X_object, &k, &options.max_iter, &options.eps,
+                                     &algorithm_name)) {
+        return NULL;
+    }
+    if (!kmeans_algorithm_from_name(algorithm_name, &options.algorithm)) {
+        PyErr_Format(PyExc_ValueError, "Unknown algorithm %s; use lloyd, hamerly, elkan or auto.", algorithm_name);
+        return NULL;
+    }
+    if (options.max_iter < 1 || options.eps < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_iter must be positive and eps cannot be negative.");
+        return NULL;
+    }
+
+    Py_buffer X_view;
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        return NULL;
+    }
+    if (k < 1 || k >= X_matrix->rows) {
+        release_matrix(X_matrix, &X_view);
+        PyErr_SetString(PyExc_ValueError, "k must be between 1 and the number of points - 1.");
+        return NULL;
+    }
+    PyObject* labels_object = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)X_matrix->rows * sizeof(int));
+    if (labels_object == NULL) {
+        release_matrix(X_matrix, &X_view);
+        return NULL;
+    }
+    int* labels = (int*)PyByteArray_AS_STRING(labels_object);
+
+    Matrix* centroids = NULL;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    centroids = kmeans(X_matrix, k, &options, labels);
+    Py_END_ALLOW_THREADS
+    release_matrix(X_matrix, &X_view);
+
+    if (centroids == NULL) {
+        Py_DECREF(labels_object);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute k-means.");
+        return NULL;
+    }
+    PyObject* centroids_view = matrix_to_memoryview(centroids);
+    if (centroids_view == NULL) {
+        Py_DECREF(labels_object);
+        return NULL;
+    }
+    PyObject* labels_view = labels_to_memoryview(labels_object);
+    if (labels_view == NULL) {
+        Py_DECREF(centroids_view);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", centroids_view, labels_view);
+}
+
+/* Wrapper function for minibatch_kmeans: minibatch_kmeans(file_name, k, batch_size=4096,
+ * max_iter=300, eps=1e-4, labels=True). The file is read batch_size points at a time and never
+ * loaded whole; with labels a last pass labels every point with its nearest final centroid.
+ * Returns centroids, or (centroids, labels) with labels. */
+static PyObject* py_minibatch_kmeans(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"file_name", "k", "batch_size", "max_iter", "eps", "labels", NULL};
+    const char* file_name;
+    int k;
+    int want_labels = 1;
+    KmeansOptions options;
+    default_kmeans_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "si|iidp", keywords, &file_name, &k, &options.batch_size,
+                                     &options.max_iter, &options.eps, &want_labels)) {
+        return NULL;
+    }
+    if (k < 1 || options.batch_size < 1 || options.max_iter < 1 || options.eps < 0) {
+        PyErr_SetString(PyExc_ValueError, "k, batch_size and max_iter must be positive and eps cannot be negative.");
+        return NULL;
+    }
+
+    Matrix* centroids = NULL;
+    long rows = 0;
+    long error_line = 0;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    MatrixReader* reader = open_matrix_reader(file_name, &error_line);
+    centroids = minibatch_kmeans(reader, k, &options, &rows, &error_line);
+    close_matrix_reader(reader);
+    Py_END_ALLOW_THREADS
+    if (centroids == NULL) {
+        if (error_line > 0) {
+            PyErr_Format(PyExc_ValueError, "%s:%ld: malformed row", file_name, error_line);
+        } else {
+            PyErr_Format(PyExc_RuntimeError, "Failed to run mini-batch k-means on %s (is k below the number of points?).",
+                         file_name);
+        }
+        return NULL;
+    }
+    if (!want_labels) {
+        return matrix_to_memoryview(centroids);
+    }
+
+    PyObject* labels_object = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)rows * sizeof(int));
+    if (labels_object == NULL) {
+        free_matrix(centroids);
+        return NULL;
+    }
+    int* labels = (int*)PyByteArray_AS_STRING(labels_object);
+    int ok = 0;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    MatrixReader* reader = open_matrix_reader(file_name, &error_line);
+    ok = label_matrix_rows(reader, centroids, options.batch_size, labels, rows, &error_line);
+    close_matrix_reader(reader);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        Py_DECREF(labels_object);
+        free_matrix(centroids);
+        if (error_line > 0) {
+            PyErr_Format(PyExc_ValueError, "%s:%ld: malformed row", file_name, error_line);
+        } else {
+            PyErr_Format(PyExc_RuntimeError, "Failed to label the points of %s (did it change since it was clustered?).",
+                         file_name);
+        }
+        return NULL;
+    }
+    PyObject* centroids_view = matrix_to_memoryview(centroids);
+    if (centroids_view == NULL) {
+        Py_DECREF(labels_object);
+        return NULL;
+    }
+    PyObject* labels_view = labels_to_memoryview(labels_object);
+    if (labels_view == NULL) {
+        Py_DECREF(centroids_view);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", centroids_view, labels_view);
+}
+
+/* Helper function to read cluster labels into a C int array of n entries. 1-D buffers of 32- or
+ * 64-bit integers (NumPy label arrays, the memoryviews returned by this module) are read directly,
+ * other sequences item by item. Every label must be in [0, n), so *k, which receives the largest
+ * label + 1, is at most n. */
+static int python_to_labels(PyObject* object, int n, int* labels, int* k) {
+    *k = 0;
+    if (PyObject_CheckBuffer(object)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(object, &view, PyBUF_ND | PyBUF_FORMAT) < 0) {
+            return 0;
+        }
+        const char* format = view.format == NULL ? "B" : view.format;
+        if (format[0] == '@' || format[0] == '=' || format[0] == '<') {
+            format++;
+        }
+        int integers = strchr("ilqn", format[0]) != NULL && format[1] == '\0'
+                       && (view.itemsize == 4 || view.itemsize == 8);
+        if (!integers || view.ndim != 1 || view.shape[0] != n) {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "labels must hold one integer per point.");
+            return 0;
+        }
+        for (int i = 0; i < n; i++) {
+            long long label = view.itemsize == 4 ? ((int*)view.buf)[i] : ((long long*)view.buf)[i];
+            if (label < 0 || label >= n) {
+                PyBuffer_Release(&view);
+                PyErr_SetString(PyExc_ValueError, "labels must be between 0 and n - 1.");
+                return 0;
+            }
+            labels[i] = (int)label;
+            *k = labels[i] >= *k ? labels[i] + 1 : *k;
+        }
+        PyBuffer_Release(&view);
+        return 1;
+    }
+    PyObject* sequence = PySequence_Fast(object, "labels must be a sequence of integers.");
+    if (sequence == NULL) {
+        return 0;
+    }
+    if (PySequence_Fast_GET_SIZE(sequence) != n) {
+        Py_DECREF(sequence);
+        PyErr_SetString(PyExc_ValueError, "labels must hold one integer per point.");
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        long label = PyLong_AsLong(PySequence_Fast_GET_ITEM(sequence, i));
+        if (label < 0 || label >= n) {
+            Py_DECREF(sequence);
+            if (!PyErr_Occurred()) {
+                PyErr_SetString(PyExc_ValueError, "labels must be between 0 and n - 1.");
+            }
+            return 0;
+        }
+        labels[i] = (int)label;
+        *k = labels[i] >= *k ? labels[i] + 1 : *k;
+    }
+    Py_DECREF(sequence);
+    return 1;
+}
+
+/* Wrapper function for silhouette_score: silhouette(X, labels, sample_size=0, seed=0, similarity=None).
+ * Scores every point like sklearn.metrics.silhouette_score, or with 0 < sample_size < n estimates
+ * the score from a sample stratified by cluster. similarity may pass sym(X), whose entries then
+ * give the distances instead of the points. Returns (score, half_width): the score and the half-width
+ * of its 95% confidence interval, 0 when every point was scored. */
+static PyObject* py_silhouette(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"X", "labels", "sample_size", "seed", "similarity", NULL};
+    PyObject* X_object;
+    PyObject* labels_object;
+    PyObject* similarity_object = Py_None;
+    int sample_size = 0;
+    unsigned long seed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ikO", keywords, &X_object, &labels_object, &sample_size,
+                                     &seed, &similarity_object)) {
+        return NULL;
+    }
+
+    Py_buffer X_view;
+    Py_buffer similarity_view;
+    similarity_view.obj = NULL;
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        return NULL;
+    }
+    int k;
+    int* labels = (int*)malloc((size_t)X_matrix->rows * sizeof(int));
+    if (labels == NULL) {
+        release_matrix(X_matrix, &X_view);
+        return PyErr_NoMemory();
+    }
+    if (!python_to_labels(labels_object, X_matrix->rows, labels, &k)) {
+        free(labels);
+        release_matrix(X_matrix, &X_view);
+        return NULL;
+    }
+    Matrix* similarity_matrix = NULL;
+    if (similarity_object != Py_None) {
+        similarity_matrix = python_to_matrix(similarity_object, &similarity_view);
+        if (similarity_matrix == NULL || similarity_matrix->rows != X_matrix->rows
+            || similarity_matrix->cols != X_matrix->rows) {
+            if (similarity_matrix != NULL) {
+                release_matrix(similarity_matrix, &similarity_view);
+                PyErr_SetString(PyExc_ValueError, "similarity must be the n x n matrix of sym(X).");
+            }
+            free(labels);
+            release_matrix(X_matrix, &X_view);
+            return NULL;
+        }
+    }
+
+    SilhouetteScore score;
+    int ok;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    ok = silhouette_score(X_matrix, similarity_matrix, labels, k, sample_size, seed, &score);
+    Py_END_ALLOW_THREADS
+    free(labels);
+    release_matrix(X_matrix, &X_view);
+    if (similarity_matrix != NULL) {
+        release_matrix(similarity_matrix, &similarity_view);
+    }
+
+    if (!ok) {
+        PyErr_SetString(PyExc_ValueError, "Failed to compute the silhouette score (are there between 2 and n - 1 clusters?).");
+        return NULL;
+    }
+    return Py_BuildValue("(dd)", score.score, score.half_width);
+}
+
+/* Wrapper function for select_symnmf_model: select(X, ks, restarts=1, seed=0, max_iter=300,
+ * eps=1e-4, method="mu", silhouette_sample=0). W = norm(X) is computed once and SymNMF is run for
+ * every k of ks and every restart on it; restart r of k gives fit(X, k, seed=seed + r). Returns
+ * (best, runs): best maps every k to the H of its restart with the lowest objective, runs holds one
+ * dict per run with k, restart, seed, iterations, seconds, objective, silhouette and half_width. */
+static PyObject* py_select(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"X", "ks", "restarts", "seed", "max_iter", "eps", "method", "silhouette_sample", NULL};
+    PyObject* X_object;
+    PyObject* ks_object;
+    const char* method_name = "mu";
+    SelectionOptions options;
+    default_selection_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ikidsi", keywords, &X_object, &ks_object, &options.restarts,
+                                     &options.seed, &options.symnmf.max_iter, &options.symnmf.eps, &method_name,
+                                     &options.silhouette_sample)) {
+        return NULL;
+    }
+    if (!symnmf_method_from_name(method_name, &options.symnmf.method)) {
+        PyErr_Format(PyExc_ValueError, "Unknown method %s; use mu, nesterov, hals or anls.", method_name);
+        return NULL;
+    }
+    if (options.restarts < 1 || options.symnmf.max_iter < 0 || options.symnmf.eps < 0 || options.silhouette_sample < 0) {
+        PyErr_SetString(PyExc_ValueError, "restarts must be positive; max_iter, eps and silhouette_sample cannot be negative.");
+        return NULL;
+    }
+    PyObject* ks_sequence = PySequence_Fast(ks_object, "ks must be a sequence of integers.");
+    if (ks_sequence == NULL) {
+        return NULL;
+    }
+    int k_count = (int)PySequence_Fast_GET_SIZE(ks_sequence);
+    int* ks = (int*)malloc((size_t)(k_count > 0 ? k_count : 1) * sizeof(int));
+    if (ks == NULL) {
+        Py_DECREF(ks_sequence);
+        return PyErr_NoMemory();
+    }
+    for (int i = 0; i < k_count; i++) {
+        ks[i] = (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(ks_sequence, i));
+        for (int j = 0; j < i && !PyErr_Occurred(); j++) {
+            if (ks[j] == ks[i]) {
+                PyErr_SetString(PyExc_ValueError, "ks cannot repeat a value.");
+            }
+        }
+        if (PyErr_Occurred()) {
+            free(ks);
+            Py_DECREF(ks_sequence);
+            return NULL;
+        }
+    }
+    Py_DECREF(ks_sequence);
+
+    Py_buffer X_view;
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        free(ks);
+        return NULL;
+    }
+    for (int i = 0; i < k_count; i++) {
+        if (ks[i] < 1 || ks[i] >= X_matrix->rows) {
+            free(ks);
+            release_matrix(X_matrix, &X_view);
+            PyErr_SetString(PyExc_ValueError, "Every k must be between 1 and the number of points - 1.");
+            return NULL;
+        }
+    }
+    if (k_count == 0) {
+        free(ks);
+        release_matrix(X_matrix, &X_view);
+        PyErr_SetString(PyExc_ValueError, "ks cannot be empty.");
+        return NULL;
+    }
+
+    ModelSelection* selection;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    selection = select_symnmf_model(X_matrix, ks, k_count, &options);
+    Py_END_ALLOW_THREADS
+    free(ks);
+    release_matrix(X_matrix, &X_view);
+    if (selection == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to run the model selection.");
+        return NULL;
+    }
+
+    PyObject* best = PyDict_New();
+    PyObject* runs = PyList_New(0);
+    int failed = best == NULL || runs == NULL;
+    for (int i = 0; i < k_count * options.restarts && !failed; i++) {
+        SelectionRun* run = &selection->runs[i];
+        PyObject* row = Py_BuildValue("{s:i,s:i,s:k,s:i,s:d,s:d,s:d,s:d}", "k", run->k, "restart", run->restart,
+                                      "seed", run->seed, "iterations", run->iterations, "seconds", run->seconds,
+                                      "objective", run->objective, "silhouette", run->silhouette,
+                                      "half_width", run->half_width);
+        failed = row == NULL || PyList_Append(runs, row) < 0;
+        Py_XDECREF(row);
+    }
+    for (int i = 0; i < k_count && !failed; i++) {
+        PyObject* key = PyLong_FromLong(selection->runs[i * options.restarts].k);
+        PyObject* H_view = matrix_to_memoryview(selection->best[i]);
+        selection->best[i] = NULL;
+        failed = key == NULL || H_view == NULL || PyDict_SetItem(best, key, H_view) < 0;
+        Py_XDECREF(key);
+        Py_XDECREF(H_view);
+    }
+    free_model_selection(selection);
+    if (failed) {
+        Py_XDECREF(best);
+        Py_XDECREF(runs);
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", best, runs);
+}
+
+/* Helper function to check the neighbor count and radius of the kNN wrappers */
+static int check_knn_arguments(int neighbors, double radius) {
+    if (neighbors < 0 || radius < 0 || (neighbors == 0 && radius == 0)) {
+        PyErr_SetString(PyExc_ValueError, "Give a positive number of neighbors, a positive radius, or both.");
+        return 0;
+    }
+    return 1;
+}
+
+/* Wrapper function for knn_sym */
+static PyObject* py_knn_sym(PyObject* self, PyObject* args) {
+    PyObject* input_object;
+    int neighbors;
+    double radius = 0.0;
+    if (!PyArg_ParseTuple(args, "Oi|d", &input_object, &neighbors, &radius) || !check_knn_arguments(neighbors, radius)) {
+        return NULL;
+    }
+
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
+    if (input_matrix == NULL) {
+        return NULL;
+    }
+
+    SparseMatrix* result_matrix;
+    Matrix* dense = NULL;
+    int failed;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    result_matrix = knn_sym(input_matrix, neighbors, radius);
+    failed = result_matrix == NULL;
+    if (!failed) {
+        dense = sparse_to_matrix(result_matrix);
+        free_sparse_matrix(result_matrix);
+    }
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
+
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute the kNN similarity matrix.");
+        return NULL;
+    }
+
+    if (dense == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    return matrix_to_memoryview(dense);
+}
+
+/* Wrapper function for knn_ddg */
+static PyObject* py_knn_ddg(PyObject* self, PyObject* args) {
+    PyObject* input_object;
+    int neighbors;
+    double radius = 0.0;
+    if (!PyArg_ParseTuple(args, "Oi|d", &input_object, &neighbors, &radius) || !check_knn_arguments(neighbors, radius)) {
+        return NULL;
+    }
+
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
+    if (input_matrix == NULL) {
+        return NULL;
+    }
+
+    Matrix* result_matrix;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    Vector* diagonal = knn_ddg(input_matrix, neighbors, radius);
+    result_matrix = diagonal_to_matrix(diagonal);
+    free_vector(diagonal);
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
+
+    if (result_matrix == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute the kNN diagonal degree matrix.");
+        return NULL;
+    }
+
+    return matrix_to_memoryview(result_matrix);
+}
+
+/* Wrapper function for knn_norm */
+static PyObject* py_knn_norm(PyObject* self, PyObject* args) {
+    PyObject* input_object;
+    int neighbors;
+    double radius = 0.0;
+    if (!PyArg_ParseTuple(args, "Oi|d", &input_object, &neighbors, &radius) || !check_knn_arguments(neighbors, radius)) {
+        return NULL;
+    }
+
+    Py_buffer input_view;
+    Matrix* input_matrix = python_to_matrix(input_object, &input_view);
+    if (input_matrix == NULL) {
+        return NULL;
+    }
+
+    SparseMatrix* result_matrix;
+    Matrix* dense = NULL;
+    int failed;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    result_matrix = knn_norm(input_matrix, neighbors, radius);
+    failed = result_matrix == NULL;
+    if (!failed) {
+        dense = sparse_to_matrix(result_matrix);
+        free_sparse_matrix(result_matrix);
+    }
+    Py_END_ALLOW_THREADS
+    release_matrix(input_matrix, &input_view);
+
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute the kNN normalized similarity matrix.");
+        return NULL;
+    }
+
+    if (dense == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    return matrix_to_memoryview(dense);
+}
+
+/* Wrapper function for the sparse symnmf. The normalized kNN graph never leaves C, so the
+ * caller passes a uniform [0, 1) draw U and the initial H is U * 2 * sqrt(mean(W) / k). */
+static PyObject* py_knn_symnmf(PyObject* self, PyObject* args) {
+    PyObject* U_object;
+    PyObject* X_object;
+    int neighbors;
+    double radius = 0.0;
+    if (!PyArg_ParseTuple(args, "OOi|d", &U_object, &X_object, &neighbors, &radius) || !check_knn_arguments(neighbors, radius)) {
+        return NULL;
+    }
+
+    Py_buffer U_view;
+    Py_buffer X_view;
+    Matrix* U_matrix = python_to_matrix(U_object, &U_view);
+    if (U_matrix == NULL) {
+        return NULL;
+    }
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        release_matrix(U_matrix, &U_view);
+        return NULL;
+    }
+
+    Matrix* result_matrix = NULL;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    SparseMatrix* W_matrix = knn_norm(X_matrix, neighbors, radius);
+    Matrix* H_matrix = NULL;
+    if (W_matrix != NULL) {
+        H_matrix = scaled_matrix(U_matrix, 2 * sqrt(sparse_mean(W_matrix) / U_matrix->cols));
+    }
+    if (H_matrix != NULL) {
+        result_matrix = sparse_symnmf(H_matrix, W_matrix);
+    }
+    free_matrix(H_matrix);
+    free_sparse_matrix(W_matrix);
+    Py_END_ALLOW_THREADS
+    release_matrix(U_matrix, &U_view);
+    release_matrix(X_matrix, &X_view);
+
+    if (result_matrix == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute the kNN symnmf matrix.");
+        return NULL;
+    }
+
+    return matrix_to_memoryview(result_matrix);
+}
+
+/* Wrapper function for the streaming symnmf, which recomputes W inside every W * H product
+ * instead of storing it. As in knn_symnmf the caller passes a uniform [0, 1) draw U. */
+static PyObject* py_streaming_symnmf(PyObject* self, PyObject* args) {
+    PyObject* U_object;
+    PyObject* X_object;
+    const char* cache_file_name = NULL;
+    if (!PyArg_ParseTuple(args, "OO|z", &U_object, &X_object, &cache_file_name)) {
+        return NULL;
+    }
+
+    Py_buffer U_view;
+    Py_buffer X_view;
+    Matrix* U_matrix = python_to_matrix(U_object, &U_view);
+    if (U_matrix == NULL) {
+        return NULL;
+    }
+    Matrix* X_matrix = python_to_matrix(X_object, &X_view);
+    if (X_matrix == NULL) {
+        release_matrix(U_matrix, &U_view);
+        return NULL;
+    }
+
+    Matrix* result_matrix = NULL;
+    int threads = requested_threads;
+    Py_BEGIN_ALLOW_THREADS
+    set_num_threads(threads);
+    StreamingSimilarity* W = create_streaming_similarity(X_matrix, 1, cache_file_name);
+    Matrix* H_matrix = NULL;
+    double mean = W == NULL ? -1.0 : streaming_mean(W);
+    if (mean >= 0) {
+        H_matrix = scaled_matrix(U_matrix, 2 * sqrt(mean / U_matrix->cols));
+    }
+    if (H_matrix != NULL) {
+        result_matrix = streaming_symnmf(H_matrix, W);
+    }
+    free_matrix(H_matrix);
+    free_streaming_similarity(W);
+    Py_END_ALLOW_THREADS
+    release_matrix(U_matrix, &U_view);
+    release_matrix(X_matrix, &X_view);
+
+    if (result_matrix == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compute the streaming symnmf matrix.");
+        return NULL;
+    }
+
+    return matrix_to_memoryview(result_matrix);
+}
+
+/* Wrapper function for set_num_threads */
+static PyObject* py_set_num_threads(PyObject* self, PyObject* args) {
+    int threads;
+    if (!PyArg_ParseTuple(args, "i", &threads)) {
+        return NULL;
+    }
+    if (threads <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Number of threads must be positive.");
+        return NULL;
+    }
+    requested_threads = threads;
+    set_num_threads(threads);
+    Py_RETURN_NONE;
 }
 
 /* Method definitions */
 static PyMethodDef SymnmfMethods[] = {
+    {"load_matrix", (PyCFunction)(void(*)(void))py_load_matrix, METH_VARARGS | METH_KEYWORDS, "Load a matrix from a CSV file or a binary matrix file: load_matrix(file_name, verify=True), verify=False skipping the checksum of a binary file."},
+    {"save_matrix", py_save_matrix, METH_VARARGS, "Write a matrix to a binary matrix file: save_matrix(matrix, file_name)."},
     {"sym", py_sym, METH_VARARGS, "Calculate the symmetric normalized similarity matrix."},
     {"ddg", py_ddg, METH_VARARGS, "Calculate the diagonal degree matrix."},
     {"norm", py_norm, METH_VARARGS, "Calculate the normalized similarity matrix."},
     {"symnmf", py_symnmf, METH_VARARGS, "Calculate the symnmf matrix."},
+    {"fit", (PyCFunction)(void(*)(void))py_fit, METH_VARARGS | METH_KEYWORDS, "Run norm, initialization and symnmf in C: fit(X, k, seed=0, max_iter=300, eps=1e-4, labels=False, init=None, tol=0.0, time_budget=0.0, callback=None, method='mu')."},
+    {"kmeans", (PyCFunction)(void(*)(void))py_kmeans, METH_VARARGS | METH_KEYWORDS, "Run k-means from the first k points like kmeans.py: kmeans(X, k, max_iter=300, eps=1e-4, algorithm='auto') returns (centroids, labels)."},
+    {"minibatch_kmeans", (PyCFunction)(void(*)(void))py_minibatch_kmeans, METH_VARARGS | METH_KEYWORDS, "Run mini-batch k-means on a file read in batches: minibatch_kmeans(file_name, k, batch_size=4096, max_iter=300, eps=1e-4, labels=True) returns (centroids, labels), or centroids."},
+    {"silhouette", (PyCFunction)(void(*)(void))py_silhouette, METH_VARARGS | METH_KEYWORDS, "Compute the silhouette score of a clustering: silhouette(X, labels, sample_size=0, seed=0, similarity=None) returns (score, half_width), half_width bounding a sampled estimate at 95%."},
+    {"select", (PyCFunction)(void(*)(void))py_select, METH_VARARGS | METH_KEYWORDS, "Run SymNMF for every k and restart on one W: select(X, ks, restarts=1, seed=0, max_iter=300, eps=1e-4, method='mu', silhouette_sample=0) returns (best H per k, list of runs)."},
+    {"knn_sym", py_knn_sym, METH_VARARGS, "Calculate the kNN similarity matrix: knn_sym(X, neighbors[, radius])."},
+    {"knn_ddg", py_knn_ddg, METH_VARARGS, "Calculate the kNN diagonal degree matrix: knn_ddg(X, neighbors[, radius])."},
+    {"knn_norm", py_knn_norm, METH_VARARGS, "Calculate the kNN normalized similarity matrix: knn_norm(X, neighbors[, radius])."},
+    {"knn_symnmf", py_knn_symnmf, METH_VARARGS, "Calculate the symnmf matrix on the kNN graph: knn_symnmf(U, X, neighbors[, radius])."},
+    {"streaming_symnmf", py_streaming_symnmf, METH_VARARGS, "Calculate the symnmf matrix without storing W: streaming_symnmf(U, X[, cache_file])."},
+    {"set_num_threads", py_set_num_threads, METH_VARARGS, "Set the number of threads the C kernels use, in calls from any Python thread."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -183,5 +1214,8 @@ static struct PyModuleDef symnmfmodule = {
 
 /* Module initialization function */
 PyMODINIT_FUNC PyInit_mysymnmf(void) {
+    if (PyType_Ready(&MatrixBufferType) < 0) {
+        return NULL;
+    }
     return PyModule_Create(&symnmfmodule);
 }
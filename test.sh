@@ -58,5 +58,44 @@ compare_outputs "similarity_matrix_3" "./symnmf sym tests/input_3.txt" "python3
 compare_outputs "diagonal_degree_matrix_3" "./symnmf ddg tests/input_3.txt" "python3 symnmf.py 7 ddg tests/input_3.txt" "tests/diagonal_degree_matrix_3.txt"
 compare_outputs "normalized_matrix_3" "./symnmf norm tests/input_3.txt" "python3 symnmf.py 7 norm tests/input_3.txt" "tests/normalized_matrix_3.txt"
 
+# Sparse mode: with every other point as a neighbor the kNN graph is the dense graph
+echo "Testing kNN mode on input_1.txt (10 points)..."
+compare_outputs "knn_normalized_matrix_1" "./symnmf --knn 9 norm tests/input_1.txt" "./symnmf norm tests/input_1.txt" "tests/normalized_matrix_1.txt"
+
+# Streaming mode: the matrices are printed without being stored, with identical values
+echo "Testing streaming mode on input_2.txt..."
+compare_outputs "streaming_similarity_matrix_2" "./symnmf --streaming sym tests/input_2.txt" "./symnmf sym tests/input_2.txt" "tests/similarity_matrix_2.txt"
+compare_outputs "streaming_normalized_matrix_2" "./symnmf --streaming norm tests/input_2.txt" "./symnmf norm tests/input_2.txt" "tests/normalized_matrix_2.txt"
+
+# Seeded symnmf goal: the streamed W gives the same H as the stored one
+echo "Testing the symnmf goal on input_2.txt (k=4)..."
+compare_outputs "streaming_symnmf_matrix_2" "./symnmf --k 4 --seed 1 --streaming symnmf tests/input_2.txt" "./symnmf --k 4 --seed 1 --max-iter 300 --eps 0.0001 symnmf tests/input_2.txt" "tests/symnmf_matrix_2.txt"
+
+# kmeans goal: the centroids of kmeans.py, whatever the number of threads, the assignment step or the batch size
+echo "Testing the kmeans goal on input_3.txt (k=7)..."
+compare_outputs "kmeans_centroids_3" "./symnmf --k 7 kmeans tests/input_3.txt" "./symnmf --threads 1 --k 7 kmeans tests/input_3.txt" "tests/kmeans_centroids_3.txt"
+compare_outputs "kmeans_hamerly_centroids_3" "./symnmf --k 7 --algorithm hamerly kmeans tests/input_3.txt" "./symnmf --k 7 --algorithm lloyd kmeans tests/input_3.txt" "tests/kmeans_centroids_3.txt"
+compare_outputs "kmeans_elkan_centroids_3" "./symnmf --k 7 --algorithm elkan kmeans tests/input_3.txt" "./symnmf --k 7 --algorithm lloyd kmeans tests/input_3.txt" "tests/kmeans_centroids_3.txt"
+compare_outputs "minibatch_kmeans_centroids_3" "./symnmf --k 7 --batch-size 1000 kmeans tests/input_3.txt" "./symnmf --k 7 --batch-size 13 kmeans tests/input_3.txt" "tests/kmeans_centroids_3.txt"
+compare_outputs "minibatch_kmeans_batches_3" "./symnmf --k 7 --batch-size 7 kmeans tests/input_3.txt" "./symnmf --k 7 kmeans tests/input_3.txt" "tests/kmeans_centroids_3.txt"
+compare_outputs "minibatch_kmeans_labels_3" "python3 tests/minibatch_labels.py 7 7 tests/input_3.txt" "python3 tests/minibatch_labels.py 7 1000 tests/input_3.txt" "tests/kmeans_labels_3.txt"
+
+# select goal: one row per (k, restart) run, whether the runs share the threads or each gets one
+echo "Testing the select goal on input_2.txt (k=2..5, 3 restarts)..."
+compare_outputs "select_runs_2" "./symnmf --threads 1 --k 5 --restarts 3 --seed 1 select tests/input_2.txt" "./symnmf --threads 4 --k 5 --restarts 3 --seed 1 select tests/input_2.txt" "tests/select_runs_2.txt"
+
+# Update rules: run to a tight tolerance from the same start, every rule reaches the
+# objective and the clustering of the multiplicative rule
+echo "Testing the update rules on input_2.txt (k=4)..."
+compare_outputs "nesterov_fit_2" "python3 tests/fit_summary.py nesterov 4 3 tests/input_2.txt" "python3 tests/fit_summary.py mu 4 3 tests/input_2.txt" "tests/fit_summary_2.txt"
+compare_outputs "hals_fit_2" "python3 tests/fit_summary.py hals 4 3 tests/input_2.txt" "python3 tests/fit_summary.py mu 4 3 tests/input_2.txt" "tests/fit_summary_2.txt"
+compare_outputs "anls_fit_2" "python3 tests/fit_summary.py anls 4 3 tests/input_2.txt" "python3 tests/fit_summary.py mu 4 3 tests/input_2.txt" "tests/fit_summary_2.txt"
+
+# Silhouette: analysis.py scores every point like sklearn, a sampled estimate must hold the
+# sklearn score within its 95% half-width
+echo "Testing the silhouette score on input_1.txt (k=5) and input_2.txt (k=4)..."
+compare_outputs "silhouette_1" "python3 analysis.py 5 tests/input_1.txt" "python3 tests/silhouette_check.py 5 tests/input_1.txt 8 0 tests/analyze_scores_1" "tests/analyze_scores_1"
+compare_outputs "silhouette_2" "python3 analysis.py 4 tests/input_2.txt" "python3 tests/silhouette_check.py 4 tests/input_2.txt 10 0 tests/analyze_scores_2" "tests/analyze_scores_2"
+
 # Cleanup temporary files
 rm -f c_output.txt py_output.txt 
\ No newline at end of file
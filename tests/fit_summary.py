@@ -0,0 +1,27 @@
+import os
+import sys
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import mysymnmf as sf
+
+
+def canonical_labels(H):
+    """Hard labels of H, renumbered in order of first appearance so that column order does not matter."""
+    numbers = {}
+    return [numbers.setdefault(label, len(numbers)) for label in np.argmax(H, axis=1)]
+
+
+def main():
+    """fit_summary.py method k seed file_name: runs SYM-NMF with the given update rule to a tight
+    tolerance and prints ||W - H H^T||_F^2 and the hard labels, for comparing update rules."""
+    method, k, seed, file_name = sys.argv[1], int(sys.argv[2]), int(sys.argv[3]), sys.argv[4]
+    X = np.asarray(sf.load_matrix(file_name))
+    W = np.asarray(sf.norm(X))
+    H = np.asarray(sf.fit(X, k, seed=seed, max_iter=5000, eps=1e-12, method=method))
+    print("%.4f" % np.linalg.norm(W - H @ H.T) ** 2)
+    print(",".join(str(label) for label in canonical_labels(H)))
+
+
+if __name__ == "__main__":
+    main()
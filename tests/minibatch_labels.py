@@ -0,0 +1,18 @@
+import os
+import sys
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import mysymnmf as sf
+
+
+def main():
+    """minibatch_labels.py k batch_size file_name: runs mini-batch k-means on the file and prints
+    the cluster of every point, found by a second pass over the file in batches."""
+    k, batch_size, file_name = int(sys.argv[1]), int(sys.argv[2]), sys.argv[3]
+    _, labels = sf.minibatch_kmeans(file_name, k, batch_size, labels=True)
+    print(",".join(str(label) for label in np.asarray(labels)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,27 @@
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import mysymnmf as sf
+from analysis import read_data, symnmf_clustering, kmeans_clustering
+
+
+def main():
+    """silhouette_check.py k file_name sample_size seed scores_file: clusters the points like
+    analysis.py, estimates both silhouette scores from a sample and prints each line of scores_file
+    whose known score lies within the 95% half-width of the estimate, or the estimate otherwise."""
+    k, file_name, sample_size, seed = int(sys.argv[1]), sys.argv[2], int(sys.argv[3]), int(sys.argv[4])
+    with open(sys.argv[5]) as scores_file:
+        known = [line.split(": ") for line in scores_file.read().splitlines()]
+    matrix = read_data(file_name)
+    labels = {"nmf": symnmf_clustering(k, matrix), "kmeans": kmeans_clustering(k, file_name)}
+    for name, value in known:
+        score, half_width = sf.silhouette(matrix, labels[name], sample_size=sample_size, seed=seed)
+        if half_width > 0 and abs(score - float(value)) <= half_width:
+            print(f"{name}: {value}")
+        else:
+            print(f"{name}: {score:.4f} +- {half_width:.4f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,301 @@
+#include <math.h>
+#include "vecmath.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECMATH_X86
+#include <immintrin.h>
+#endif
+
+/* Cody-Waite split of ln 2: LN2_HI has trailing zero bits, so n * LN2_HI is exact for |n| < 2^11 */
+#define LOG2E 1.44269504088896338700e+00
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+
+/* sum_of_square_roots keeps this many partial sums, partial sum l taking the values j with
+ * j % SQRT_SUM_LANES == l, and adds them up in a fixed tree, so every kernel returns the same bits */
+#define SQRT_SUM_LANES 8
+
+/* Arguments are clamped to this range; beyond it exp is 0 or infinity anyway */
+#define EXP_MIN_ARGUMENT -746.0
+#define EXP_MAX_ARGUMENT 710.0
+
+/* Taylor coefficients 1/k! of e^r for k = 13 down to 2 */
+#define EXP_C13 1.6059043836821613e-10
+#define EXP_C12 2.0876756987868099e-09
+#define EXP_C11 2.5052108385441720e-08
+#define EXP_C10 2.7557319223985893e-07
+#define EXP_C9 2.7557319223985888e-06
+#define EXP_C8 2.4801587301587302e-05
+#define EXP_C7 1.9841269841269841e-04
+#define EXP_C6 1.3888888888888889e-03
+#define EXP_C5 8.3333333333333333e-03
+#define EXP_C4 4.1666666666666667e-02
+#define EXP_C3 1.6666666666666667e-01
+#define EXP_C2 5.0000000000000000e-01
+
+typedef enum VecmathLevel {
+    VECMATH_SCALAR,
+    VECMATH_AVX2,
+    VECMATH_AVX512
+} VecmathLevel;
+
+/* Helper function to pick the widest instruction set the running CPU supports */
+static VecmathLevel select_level(void) {
+#ifdef VECMATH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return VECMATH_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return VECMATH_AVX2;
+    }
+#endif
+    return VECMATH_SCALAR;
+}
+
+/* Portable squared distances */
+static void squared_distances_scalar(const double *x, const double *packed, size_t packed_ld,
+                                     int count, int d, double *out) {
+    int j, c;
+    double sum, diff;
+    for (j = 0; j < count; j++) {
+        sum = 0.0;
+        for (c = 0; c < d; c++) {
+            diff = x[c] - packed[c * packed_ld + j];
+            sum += diff * diff;
+        }
+        out[j] = sum;
+    }
+}
+
+/* Helper function to add up the SQRT_SUM_LANES partial sums of sum_of_square_roots */
+static double combine_lanes(const double *lanes) {
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+/* Portable sum of square roots, emulating the eight lanes of the vector kernels */
+static double sum_of_square_roots_scalar(const double *values, int count) {
+    double lanes[SQRT_SUM_LANES] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    int j;
+    for (j = 0; j < count; j++) {
+        lanes[j % SQRT_SUM_LANES] += sqrt(values[j]);
+    }
+    return combine_lanes(lanes);
+}
+
+#ifdef VECMATH_X86
+
+/* Helper function to build the AVX2 lane mask selecting the first count lanes */
+__attribute__((target("avx2,fma")))
+static __m256i avx2_tail_mask(int count) {
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(count), _mm256_set_epi64x(3, 2, 1, 0));
+}
+
+/* AVX2 squared distances, four points per vector with a masked tail */
+__attribute__((target("avx2,fma")))
+static void squared_distances_avx2(const double *x, const double *packed, size_t packed_ld,
+                                   int count, int d, double *out) {
+    __m256d sum, diff;
+    __m256i mask;
+    int j, c;
+    for (j = 0; j < count; j += 4) {
+        mask = avx2_tail_mask(count - j);
+        sum = _mm256_setzero_pd();
+        for (c = 0; c < d; c++) {
+            diff = _mm256_sub_pd(_mm256_set1_pd(x[c]), _mm256_maskload_pd(packed + c * packed_ld + j, mask));
+            sum = _mm256_fmadd_pd(diff, diff, sum);
+        }
+        _mm256_maskstore_pd(out + j, mask, sum);
+    }
+}
+
+/* AVX-512 squared distances, eight points per vector with a masked tail */
+__attribute__((target("avx512f")))
+static void squared_distances_avx512(const double *x, const double *packed, size_t packed_ld,
+                                     int count, int d, double *out) {
+    __m512d sum, diff;
+    __mmask8 mask;
+    int j, c;
+    for (j = 0; j < count; j += 8) {
+        mask = (__mmask8)(count - j >= 8 ? 0xFF : (1 << (count - j)) - 1);
+        sum = _mm512_setzero_pd();
+        for (c = 0; c < d; c++) {
+            diff = _mm512_sub_pd(_mm512_set1_pd(x[c]), _mm512_maskz_loadu_pd(mask, packed + c * packed_ld + j));
+            sum = _mm512_fmadd_pd(diff, diff, sum);
+        }
+        _mm512_mask_storeu_pd(out + j, mask, sum);
+    }
+}
+
+/* AVX2 sum of square roots: two vectors hold the eight partial sums, with a masked tail */
+__attribute__((target("avx2,fma")))
+static double sum_of_square_roots_avx2(const double *values, int count) {
+    __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+    double lanes[SQRT_SUM_LANES];
+    int j;
+    for (j = 0; j < count; j += SQRT_SUM_LANES) {
+        low = _mm256_add_pd(low, _mm256_sqrt_pd(_mm256_maskload_pd(values + j, avx2_tail_mask(count - j))));
+        if (count - j > 4) {
+            high = _mm256_add_pd(high, _mm256_sqrt_pd(_mm256_maskload_pd(values + j + 4,
+                                                                         avx2_tail_mask(count - j - 4))));
+        }
+    }
+    _mm256_storeu_pd(lanes, low);
+    _mm256_storeu_pd(lanes + 4, high);
+    return combine_lanes(lanes);
+}
+
+/* AVX-512 sum of square roots: one vector holds the eight partial sums, with a masked tail */
+__attribute__((target("avx512f")))
+static double sum_of_square_roots_avx512(const double *values, int count) {
+    __m512d sum = _mm512_setzero_pd();
+    __mmask8 mask;
+    double lanes[SQRT_SUM_LANES];
+    int j;
+    for (j = 0; j < count; j += SQRT_SUM_LANES) {
+        mask = (__mmask8)(count - j >= 8 ? 0xFF : (1 << (count - j)) - 1);
+        sum = _mm512_add_pd(sum, _mm512_sqrt_pd(_mm512_maskz_loadu_pd(mask, values + j)));
+    }
+    _mm512_storeu_pd(lanes, sum);
+    return combine_lanes(lanes);
+}
+
+/* AVX2 exp: 2^n is assembled from exponent bits as 2^(n/2) * 2^(n - n/2) */
+__attribute__((target("avx2,fma")))
+static void scaled_exp_avx2(double *values, int count, double scale) {
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    __m256d x, n, half, r, p;
+    __m256i bits, mask, exponent_bias = _mm256_set1_epi64x(1023);
+    int j;
+    for (j = 0; j < count; j += 4) {
+        mask = avx2_tail_mask(count - j);
+        x = _mm256_mul_pd(_mm256_maskload_pd(values + j, mask), _mm256_set1_pd(scale));
+        x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(EXP_MAX_ARGUMENT)), _mm256_set1_pd(EXP_MIN_ARGUMENT));
+        n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_HI), x);
+        r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_LO), r);
+        p = _mm256_fmadd_pd(_mm256_set1_pd(EXP_C13), r, _mm256_set1_pd(EXP_C12));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C11));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C10));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C9));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C8));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C7));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C6));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C5));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C4));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C3));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C2));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+        half = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+        n = _mm256_sub_pd(n, half);
+        bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(half, magic)), _mm256_castpd_si256(magic));
+        p = _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(bits, exponent_bias), 52)));
+        bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)), _mm256_castpd_si256(magic));
+        p = _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(bits, exponent_bias), 52)));
+        _mm256_maskstore_pd(values + j, mask, p);
+    }
+}
+
+/* AVX-512 exp: scalef applies 2^n with a single rounding, including subnormal results */
+__attribute__((target("avx512f")))
+static void scaled_exp_avx512(double *values, int count, double scale) {
+    __m512d x, n, r, p;
+    __mmask8 mask;
+    int j;
+    for (j = 0; j < count; j += 8) {
+        mask = (__mmask8)(count - j >= 8 ? 0xFF : (1 << (count - j)) - 1);
+        x = _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, values + j), _mm512_set1_pd(scale));
+        x = _mm512_max_pd(_mm512_min_pd(x, _mm512_set1_pd(EXP_MAX_ARGUMENT)), _mm512_set1_pd(EXP_MIN_ARGUMENT));
+        n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_HI), x);
+        r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_LO), r);
+        p = _mm512_fmadd_pd(_mm512_set1_pd(EXP_C13), r, _mm512_set1_pd(EXP_C12));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C11));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C10));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C9));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C8));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C7));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C6));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C5));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C4));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C3));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C2));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+        _mm512_mask_storeu_pd(values + j, mask, _mm512_scalef_pd(p, n));
+    }
+}
+
+#endif
+
+/* Function to pack points into coordinate-major order */
+void pack_coordinates(const double *points, size_t ld, int count, int d, double *packed, size_t packed_ld) {
+    int j, c;
+    for (j = 0; j < count; j++) {
+        for (c = 0; c < d; c++) {
+            packed[c * packed_ld + j] = points[j * ld + c];
+        }
+    }
+}
+
+/* Function to compute the squared distances from one point to a block of points */
+void squared_distances(const double *x, const double *packed, size_t packed_ld, int count, int d, double *out) {
+    switch (select_level()) {
+#ifdef VECMATH_X86
+    case VECMATH_AVX512:
+        squared_distances_avx512(x, packed, packed_ld, count, d, out);
+        return;
+    case VECMATH_AVX2:
+        squared_distances_avx2(x, packed, packed_ld, count, d, out);
+        return;
+#endif
+    default:
+        squared_distances_scalar(x, packed, packed_ld, count, d, out);
+    }
+}
+
+/* Function to exponentiate a block of scaled values in place */
+void scaled_exp(double *values, int count, double scale) {
+    int j;
+    switch (select_level()) {
+#ifdef VECMATH_X86
+    case VECMATH_AVX512:
+        scaled_exp_avx512(values, count, scale);
+        return;
+    case VECMATH_AVX2:
+        scaled_exp_avx2(values, count, scale);
+        return;
+#endif
+    default:
+        for (j = 0; j < count; j++) {
+            values[j] = exp(scale * values[j]);
+        }
+    }
+}
+
+/* Function to sum the square roots of a block of values, in the same order on every CPU */
+double sum_of_square_roots(const double *values, int count) {
+    switch (select_level()) {
+#ifdef VECMATH_X86
+    case VECMATH_AVX512:
+        return sum_of_square_roots_avx512(values, count);
+    case VECMATH_AVX2:
+        return sum_of_square_roots_avx2(values, count);
+#endif
+    default:
+        return sum_of_square_roots_scalar(values, count);
+    }
+}
+
+/* Function to report which vector kernels are in use */
+const char* vecmath_kernel_name(void) {
+    switch (select_level()) {
+    case VECMATH_AVX512:
+        return "avx512";
+    case VECMATH_AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
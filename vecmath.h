@@ -0,0 +1,27 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <stddef.h>
+
+/* Copies count points of dimension d, stored row-major with leading dimension ld, into a
+ * coordinate-major block: coordinate c of point j goes to packed[c * packed_ld + j] */
+void pack_coordinates(const double *points, size_t ld, int count, int d, double *packed, size_t packed_ld);
+
+/* Computes out[j] = ||x - y_j||^2 for the first count points y_j of a coordinate-major block */
+void squared_distances(const double *x, const double *packed, size_t packed_ld, int count, int d, double *out);
+
+/* Replaces every values[j] by exp(scale * values[j]).
+ * The vector kernels reduce the argument to r in [-ln2/2, ln2/2] (Cody-Waite, two-part ln2),
+ * evaluate a degree-13 Taylor polynomial of e^r and scale by 2^n in two steps, so subnormal
+ * results and overflow to infinity behave like libm. Against glibc exp the relative error is
+ * below 2.5e-16 (about 1 ulp) for results in the normal range; arguments must be finite. */
+void scaled_exp(double *values, int count, double scale);
+
+/* Returns the sum of sqrt(values[j]) over count non-negative values, bit for bit the same
+ * whichever vector kernels are selected */
+double sum_of_square_roots(const double *values, int count);
+
+/* Returns the name of the vector kernels selected for this CPU */
+const char* vecmath_kernel_name(void);
+
+#endif